@@ -0,0 +1,44 @@
+#include "logging/Logging.hpp"
+
+#include "conffwk/Configuration.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/LaunchPlan.hpp"
+
+#include <iostream>
+#include <string>
+
+using namespace dunedaq;
+
+int main(int argc, char* argv[]) {
+
+  if (argc < 4) {
+    std::cout << "Usage: " << argv[0] << " session database-file plan-file\n"
+              << "  Writes the launch plan of the session to plan-file unless it is up to date\n";
+    return 0;
+  }
+
+  std::string sessionName(argv[1]);
+  std::string dbfile(argv[2]);
+  std::string planfile(argv[3]);
+  dunedaq::logging::Logging::setup(sessionName, "build_launch_plan");
+
+  // The hash covers the files included by the database as well
+  auto confdb = new conffwk::Configuration("oksconflibs:" + dbfile);
+  auto hash = appmodel::database_hash(appmodel::database_files(*confdb, dbfile), sessionName);
+
+  if (appmodel::read_launch_plan(planfile, hash)) {
+    std::cout << planfile << " is up to date (" << hash << ")\n";
+    return 0;
+  }
+
+  auto session = confdb->get<confmodel::Session>(sessionName);
+  if (session==nullptr) {
+    std::cerr << "Session " << sessionName << " not found in database\n";
+    return -1;
+  }
+
+  auto plan = appmodel::build_launch_plan(confdb, session, hash);
+  appmodel::write_launch_plan(plan, planfile);
+  std::cout << "Wrote launch plan for " << plan.apps.size() << " applications to " << planfile << " (" << hash << ")\n";
+}
@@ -0,0 +1,103 @@
+/**
+ * @file freeze_generated_modules.cxx
+ *
+ * Run generate_modules once for every enabled SmartDaqApplication of a
+ * session and save the result, one database file per application, so
+ * that the applications can start without running the generators
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "logging/Logging.hpp"
+
+#include "conffwk/Configuration.hpp"
+
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/LaunchPlan.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    std::cout << "Usage: " << argv[0] << " <session> <database-file> <output-directory>\n"
+              << "  Writes <output-directory>/<app>.frozen.data.xml for every enabled SmartDaqApplication.\n"
+              << "  Start an application with its frozen file as database to skip module generation.\n";
+    return 0;
+  }
+
+  std::string sessionName(argv[1]);
+  std::string dbfile(std::filesystem::absolute(argv[2]).string());
+  std::filesystem::path outdir(argv[3]);
+
+  logging::Logging::setup(sessionName, "freeze_generated_modules");
+
+  std::filesystem::create_directories(outdir);
+
+  std::vector<std::string> appNames;
+  std::vector<std::string> dbfiles;
+  std::string hash;
+  {
+    conffwk::Configuration confdb("oksconflibs:" + dbfile);
+    // The hash covers the files included by the database as well
+    dbfiles = appmodel::database_files(confdb, dbfile);
+    hash = appmodel::database_hash(dbfiles, sessionName);
+    auto session = confdb.get<confmodel::Session>(sessionName);
+    if (session == nullptr) {
+      std::cerr << "Session " << sessionName << " not found in database\n";
+      return -1;
+    }
+    for (auto app : session->get_enabled_applications()) {
+      if (app->cast<appmodel::SmartDaqApplication>() != nullptr) {
+        appNames.push_back(app->UID());
+      }
+    }
+  }
+
+  // Each application is generated in a fresh Configuration: generators of
+  // different applications may create objects with the same uid, as each of
+  // them normally runs in its own process
+  for (auto& appName : appNames) {
+    conffwk::Configuration confdb("oksconflibs:" + dbfile);
+    auto session = confdb.get<confmodel::Session>(sessionName);
+    auto app = confdb.get<appmodel::SmartDaqApplication>(appName);
+
+    std::string frozenFile((outdir / (appName + ".frozen.data.xml")).string());
+    confdb.create(frozenFile, std::list<std::string>{ dbfile });
+
+    std::vector<const confmodel::DaqModule*> modules;
+    try {
+      modules = app->generate_modules(&confdb, frozenFile, session);
+    }
+    catch (appmodel::BadConf& exc) {
+      std::cerr << "Failed to generate modules of " << appName << ": " << exc << std::endl;
+      confdb.abort();
+      return -1;
+    }
+
+    std::vector<const conffwk::ConfigObject*> moduleObjs;
+    for (auto module : modules) {
+      moduleObjs.push_back(&module->config_object());
+    }
+    conffwk::ConfigObject frozenObj;
+    confdb.create(frozenFile, "FrozenModuleSet", "frozen-" + appName, frozenObj);
+    frozenObj.set_by_val<std::string>("database_hash", hash);
+    frozenObj.set_by_val<std::vector<std::string>>("database_files", dbfiles);
+    frozenObj.set_obj("application", &app->config_object());
+    frozenObj.set_objs("modules", moduleObjs);
+    confdb.commit("Frozen generated modules of " + appName);
+
+    std::cout << appName << ": " << modules.size() << " modules frozen in " << frozenFile << std::endl;
+  }
+}
@@ -0,0 +1,324 @@
+/**
+ * @file generation_server.cxx
+ *
+ * Long lived service answering module generation requests over a Unix
+ * socket. The modules generated for each application are committed to a
+ * frozen module file in the output directory, as freeze_generated_modules
+ * does, and kept until one of the database files changes
+ *
+ * Requests are single lines:
+ *   generate <database-file> <session> <smart-app>
+ *   generate-session <database-file> <session>
+ *   drop <database-file>
+ *   quit
+ * and are answered, for every application, by one "module <app> <uid>
+ * <class>" line per generated module and a "file <app> <path>" line naming
+ * its frozen module file, followed by "ok <number of modules>", or by
+ * "error <message>".
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "logging/Logging.hpp"
+
+#include "conffwk/Configuration.hpp"
+
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/LaunchPlan.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+
+namespace {
+
+struct Module
+{
+  std::string uid;
+  std::string class_name;
+};
+
+// The modules generated for one application and the file holding them
+struct Generated
+{
+  std::string file;
+  std::vector<Module> modules;
+};
+
+// Everything known about one database file
+struct Database
+{
+  // The database and the files it includes
+  std::vector<std::string> files;
+  // Modification times of the files
+  std::map<std::string, std::filesystem::file_time_type> stamps;
+  // Session -> enabled SmartDaqApplications
+  std::map<std::string, std::vector<std::string>> sessions;
+  // (session, app) -> generated modules
+  std::map<std::pair<std::string, std::string>, Generated> generated;
+};
+
+std::map<std::string, Database> s_databases;
+std::filesystem::path s_output_directory;
+
+bool
+up_to_date(const Database& db)
+{
+  for (auto& [file, stamp] : db.stamps) {
+    std::error_code ec;
+    if (std::filesystem::last_write_time(file, ec) != stamp || ec) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The cached database entry, (re)indexed if it is new or one of its files changed
+Database&
+database(const std::string& dbfile)
+{
+  auto it = s_databases.find(dbfile);
+  if (it != s_databases.end() && up_to_date(it->second)) {
+    return it->second;
+  }
+  if (it != s_databases.end()) {
+    TLOG() << "Reloading " << dbfile;
+    s_databases.erase(it);
+  }
+
+  conffwk::Configuration confdb("oksconflibs:" + dbfile);
+  Database db;
+  db.files = appmodel::database_files(confdb, dbfile);
+  for (auto& file : db.files) {
+    std::error_code ec;
+    auto stamp = std::filesystem::last_write_time(file, ec);
+    if (!ec) {
+      db.stamps[file] = stamp;
+    }
+  }
+  std::vector<const confmodel::Session*> sessions;
+  confdb.get(sessions);
+  for (auto session : sessions) {
+    auto& apps = db.sessions[session->UID()];
+    for (auto app : session->get_enabled_applications()) {
+      if (app->cast<appmodel::SmartDaqApplication>() != nullptr) {
+        apps.push_back(app->UID());
+      }
+    }
+  }
+  return s_databases[dbfile] = std::move(db);
+}
+
+// Generated in a fresh Configuration: generators of different applications
+// may create objects with the same uid. The result is committed to
+// <output-directory>/<database hash>/<app>.frozen.data.xml, with the
+// FrozenModuleSet that lets the application start from it.
+const Generated&
+generate(const std::string& dbfile, Database& db, const std::string& session_name, const std::string& app_name)
+{
+  auto key = std::make_pair(session_name, app_name);
+  auto it = db.generated.find(key);
+  if (it != db.generated.end()) {
+    return it->second;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto hash = appmodel::database_hash(db.files, session_name);
+  auto outdir = s_output_directory / hash;
+  std::filesystem::create_directories(outdir);
+  std::string frozen_file((outdir / (app_name + ".frozen.data.xml")).string());
+  std::filesystem::remove(frozen_file);
+
+  conffwk::Configuration confdb("oksconflibs:" + dbfile);
+  auto session = confdb.get<confmodel::Session>(session_name);
+  if (session == nullptr) {
+    throw(appmodel::BadConf(ERS_HERE, "Session " + session_name + " not found in " + dbfile));
+  }
+  auto app = confdb.get<appmodel::SmartDaqApplication>(app_name);
+  if (app == nullptr) {
+    throw(appmodel::BadConf(ERS_HERE, "SmartDaqApplication " + app_name + " not found in " + dbfile));
+  }
+
+  confdb.create(frozen_file, std::list<std::string>{ dbfile });
+  std::vector<const confmodel::DaqModule*> modules;
+  try {
+    modules = app->generate_modules(&confdb, frozen_file, session);
+  }
+  catch (...) {
+    confdb.abort();
+    throw;
+  }
+
+  Generated result{ frozen_file, {} };
+  std::vector<const conffwk::ConfigObject*> module_objs;
+  for (auto module : modules) {
+    result.modules.push_back({ module->UID(), module->class_name() });
+    module_objs.push_back(&module->config_object());
+  }
+  conffwk::ConfigObject frozen_obj;
+  confdb.create(frozen_file, "FrozenModuleSet", "frozen-" + app_name, frozen_obj);
+  frozen_obj.set_by_val<std::string>("database_hash", hash);
+  frozen_obj.set_by_val<std::vector<std::string>>("database_files", db.files);
+  frozen_obj.set_obj("application", &app->config_object());
+  frozen_obj.set_objs("modules", module_objs);
+  confdb.commit("Generated modules of " + app_name);
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  TLOG_DEBUG(5) << "Generated " << result.modules.size() << " modules for " << app_name << " in " << elapsed.count()
+                << " ms";
+  return db.generated[key] = std::move(result);
+}
+
+void
+reply_generated(std::ostream& out, const std::string& app, const Generated& generated)
+{
+  for (auto& module : generated.modules) {
+    out << "module " << app << " " << module.uid << " " << module.class_name << "\n";
+  }
+  out << "file " << app << " " << generated.file << "\n";
+}
+
+void
+reply_error(std::ostream& out, std::string what)
+{
+  std::replace(what.begin(), what.end(), '\n', ' ');
+  out << "error " << what << "\n";
+}
+
+// Returns false when the server should stop
+bool
+handle(const std::string& line, std::ostream& out)
+{
+  std::istringstream in(line);
+  std::string command, dbfile, session, app;
+  in >> command >> dbfile >> session >> app;
+  if (!dbfile.empty()) {
+    dbfile = std::filesystem::absolute(dbfile).string();
+  }
+
+  try {
+    if (command == "quit") {
+      out << "ok 0\n";
+      return false;
+    }
+    if (command == "drop" && !dbfile.empty()) {
+      s_databases.erase(dbfile);
+      out << "ok 0\n";
+    }
+    else if (command == "generate" && !app.empty()) {
+      auto& generated = generate(dbfile, database(dbfile), session, app);
+      reply_generated(out, app, generated);
+      out << "ok " << generated.modules.size() << "\n";
+    }
+    else if (command == "generate-session" && !session.empty()) {
+      auto& db = database(dbfile);
+      auto sit = db.sessions.find(session);
+      if (sit == db.sessions.end()) {
+        throw(appmodel::BadConf(ERS_HERE, "Session " + session + " not found in " + dbfile));
+      }
+      size_t count = 0;
+      for (auto& session_app : sit->second) {
+        auto& generated = generate(dbfile, db, session, session_app);
+        reply_generated(out, session_app, generated);
+        count += generated.modules.size();
+      }
+      out << "ok " << count << "\n";
+    }
+    else {
+      out << "error unknown request: " << line << "\n";
+    }
+  }
+  catch (ers::Issue& exc) {
+    reply_error(out, exc.what());
+  }
+  catch (std::exception& exc) {
+    // Filesystem and conffwk errors must not stop the server either
+    reply_error(out, exc.what());
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0] << " <socket-path> <output-directory>\n"
+              << "  Generated modules are written to <output-directory>/<database-hash>/<app>.frozen.data.xml\n";
+    return 0;
+  }
+
+  std::string socketPath(argv[1]);
+  s_output_directory = std::filesystem::absolute(argv[2]);
+  logging::Logging::setup("appmodel", "generation_server");
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (listener < 0 || socketPath.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Cannot create socket " << socketPath << std::endl;
+    return -1;
+  }
+  std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(socketPath.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+    std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+    return -1;
+  }
+  TLOG() << "Listening on " << socketPath;
+
+  // Requests are served one at a time, conffwk and the generators are not
+  // meant to be used concurrently
+  bool running = true;
+  while (running) {
+    int conn = accept(listener, nullptr, nullptr);
+    if (conn < 0) {
+      continue;
+    }
+    std::string buffer;
+    char chunk[4096];
+    ssize_t n;
+    while (running && (n = read(conn, chunk, sizeof(chunk))) > 0) {
+      buffer.append(chunk, n);
+      size_t eol;
+      while (running && (eol = buffer.find('\n')) != std::string::npos) {
+        std::ostringstream reply;
+        running = handle(buffer.substr(0, eol), reply);
+        buffer.erase(0, eol + 1);
+        auto data = reply.str();
+        for (size_t sent = 0; sent < data.size();) {
+          auto w = write(conn, data.data() + sent, data.size() - sent);
+          if (w <= 0) {
+            break;
+          }
+          sent += w;
+        }
+      }
+    }
+    close(conn);
+  }
+
+  close(listener);
+  unlink(socketPath.c_str());
+}
@@ -0,0 +1,108 @@
+/**
+ * @file slice_application_config.cxx
+ *
+ * Write the part of a session database needed by one SmartDaqApplication,
+ * with its generated modules frozen, to a standalone database file
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "logging/Logging.hpp"
+
+#include "conffwk/Configuration.hpp"
+
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/ConfigSlice.hpp"
+#include "appmodel/LaunchPlan.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+
+// Schema files included, directly or not, by the database
+std::list<std::string>
+schema_includes(const conffwk::Configuration& confdb, const std::string& dbfile)
+{
+  std::list<std::string> schemas;
+  std::set<std::string> seen{ dbfile };
+  std::list<std::string> pending{ dbfile };
+  while (!pending.empty()) {
+    std::list<std::string> includes;
+    confdb.get_includes(pending.front(), includes);
+    pending.pop_front();
+    for (auto& include : includes) {
+      if (!seen.insert(include).second) {
+        continue;
+      }
+      if (include.find(".schema.xml") != std::string::npos) {
+        schemas.push_back(include);
+      }
+      else {
+        pending.push_back(include);
+      }
+    }
+  }
+  return schemas;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 5) {
+    std::cout << "Usage: " << argv[0] << " <session> <smart-app> <database-file> <slice-file>\n";
+    return 0;
+  }
+
+  std::string sessionName(argv[1]);
+  std::string appName(argv[2]);
+  std::string dbfile(std::filesystem::absolute(argv[3]).string());
+  std::string sliceFile(argv[4]);
+
+  logging::Logging::setup(sessionName, "slice_application_config");
+
+  conffwk::Configuration confdb("oksconflibs:" + dbfile);
+  auto session = confdb.get<confmodel::Session>(sessionName);
+  if (session == nullptr) {
+    std::cerr << "Session " << sessionName << " not found in database\n";
+    return -1;
+  }
+  auto app = confdb.get<appmodel::SmartDaqApplication>(appName);
+  if (app == nullptr) {
+    std::cerr << "SmartDaqApplication " << appName << " not found in database\n";
+    return -1;
+  }
+
+  auto dbfiles = appmodel::database_files(confdb, dbfile);
+
+  // Generate into a scratch file that is never committed
+  std::string scratchFile(sliceFile + ".generated.data.xml");
+  confdb.create(scratchFile, std::list<std::string>{ dbfile });
+  try {
+    auto modules = app->generate_modules(&confdb, scratchFile, session);
+    auto slice = appmodel::application_slice(confdb, session, app, modules);
+    appmodel::write_application_slice(confdb,
+                                      slice,
+                                      app,
+                                      modules,
+                                      appmodel::database_hash(dbfiles, sessionName),
+                                      dbfiles,
+                                      sliceFile,
+                                      schema_includes(confdb, dbfile));
+    std::cout << "Wrote " << slice.size() << " objects for " << appName << " to " << sliceFile << std::endl;
+  }
+  catch (appmodel::BadConf& exc) {
+    std::cerr << "Failed to slice configuration of " << appName << ": " << exc << std::endl;
+    confdb.abort();
+    return -1;
+  }
+  confdb.abort();
+}
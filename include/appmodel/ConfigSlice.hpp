@@ -0,0 +1,66 @@
+/**
+ * @file ConfigSlice.hpp
+ *
+ * Extraction of the part of a session database that one application needs,
+ * into a standalone database file
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef APPMODEL_CONFIGSLICE_HPP
+#define APPMODEL_CONFIGSLICE_HPP
+
+#include "conffwk/Configuration.hpp"
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/SmartDaqApplication.hpp"
+
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+/**
+ * Objects reachable from roots through relationships, roots included, in
+ * breadth-first order. Relationships named "Class.relationship" in stop are
+ * not followed from objects of that class or its subclasses.
+ */
+std::vector<conffwk::ConfigObject> reference_closure(conffwk::Configuration& confdb,
+                                                     const std::vector<conffwk::ConfigObject>& roots,
+                                                     const std::set<std::string>& stop = {});
+
+/**
+ * Objects one application needs at run time: the session with only the
+ * segments leading to the application, the application itself and the
+ * modules generated for it, with everything they reference
+ */
+std::vector<conffwk::ConfigObject> application_slice(conffwk::Configuration& confdb,
+                                                     const confmodel::Session* session,
+                                                     const SmartDaqApplication* app,
+                                                     const std::vector<const confmodel::DaqModule*>& modules);
+
+/**
+ * Copy objects into a new database file that includes only schema_files.
+ * The segments and applications relationships of Segments are restricted
+ * to the copied objects. A FrozenModuleSet is added for app so that it
+ * does not run its generator, which may need objects outside the slice.
+ * database_hash is the hash of database_files, the database the objects
+ * were read from.
+ */
+void write_application_slice(conffwk::Configuration& confdb,
+                             const std::vector<conffwk::ConfigObject>& objects,
+                             const SmartDaqApplication* app,
+                             const std::vector<const confmodel::DaqModule*>& modules,
+                             const std::string& database_hash,
+                             const std::vector<std::string>& database_files,
+                             const std::string& slice_file,
+                             const std::list<std::string>& schema_files);
+
+} // namespace dunedaq::appmodel
+
+#endif // APPMODEL_CONFIGSLICE_HPP
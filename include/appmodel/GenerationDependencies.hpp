@@ -0,0 +1,74 @@
+/**
+ * @file GenerationDependencies.hpp
+ *
+ * Dependency graph between the objects created by generate_modules and the
+ * configuration objects they were generated from
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef APPMODEL_GENERATIONDEPENDENCIES_HPP
+#define APPMODEL_GENERATIONDEPENDENCIES_HPP
+
+#include "conffwk/Configuration.hpp"
+#include "conffwk/DalObject.hpp"
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/SmartDaqApplication.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+/**
+ * Objects are identified by their full name, uid@class.
+ *
+ * A generated object depends on the objects it references, directly or
+ * through other objects, on its application and on the objects of other
+ * applications that the generator read. Generators report those reads with
+ * note_read() when they inspect the applications of the session.
+ */
+class GenerationDependencies
+{
+public:
+  /**
+   * Run generate_modules of app and record the dependencies of every object
+   * it creates in dbfile
+   */
+  std::vector<const confmodel::DaqModule*> generate(conffwk::Configuration* confdb,
+                                                    const std::string& dbfile,
+                                                    const confmodel::Session* session,
+                                                    const SmartDaqApplication* app);
+
+  // Configuration objects the generated object depends on
+  std::set<std::string> sources_of(const std::string& generated) const;
+
+  // Generated objects that depend on object
+  std::set<std::string> affected_by(const std::string& object) const;
+
+  // Applications with at least one generated object depending on object
+  std::set<std::string> applications_affected_by(const std::string& object) const;
+
+  // Generated object -> objects it depends on
+  const std::map<std::string, std::set<std::string>>& dependencies() const { return m_dependencies; }
+
+  /**
+   * Record that the generator running on this thread read obj. Does
+   * nothing outside GenerationDependencies::generate().
+   */
+  static void note_read(const conffwk::DalObject* obj);
+
+private:
+  std::map<std::string, std::set<std::string>> m_dependencies;
+  std::map<std::string, std::string> m_application_of;
+};
+
+} // namespace dunedaq::appmodel
+
+#endif // APPMODEL_GENERATIONDEPENDENCIES_HPP
@@ -0,0 +1,78 @@
+/**
+ * @file LaunchPlan.hpp
+ *
+ * Precomputed host, environment and command line of every enabled
+ * application of a session, for process managers that boot the same
+ * configuration many times
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef APPMODEL_LAUNCHPLAN_HPP
+#define APPMODEL_LAUNCHPLAN_HPP
+
+#include "conffwk/Configuration.hpp"
+#include "confmodel/Session.hpp"
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+struct AppLaunchEntry
+{
+  std::string uid;
+  std::string host;
+  std::string application_name;
+  std::map<std::string, std::string> environment;
+  std::vector<std::string> commandline;
+};
+
+struct LaunchPlan
+{
+  std::string session;
+  std::string database_hash;
+  std::string rte_script;
+  // Segment controllers and applications, depth first, controllers after
+  // the applications of their nested segments as in app_environment_cli
+  std::vector<AppLaunchEntry> apps;
+};
+
+/**
+ * The database file dbfile followed by every file it includes, directly or
+ * not. Relative includes are looked up next to the including file, then
+ * in DUNEDAQ_DB_PATH; includes that cannot be found are left out.
+ */
+std::vector<std::string> database_files(const conffwk::Configuration& confdb, const std::string& dbfile);
+
+/**
+ * Hash of the contents of the database files and the session name, used
+ * as the key of a cached plan. Pass database_files() so that changes to
+ * included files are seen.
+ */
+std::string database_hash(const std::vector<std::string>& files, const std::string& session_name);
+
+/**
+ * Walk the enabled segments of the session and evaluate the host, merged
+ * environment (session, then application) and command line of every
+ * enabled application
+ */
+LaunchPlan build_launch_plan(conffwk::Configuration* confdb,
+                             const confmodel::Session* session,
+                             const std::string& database_hash);
+
+void write_launch_plan(const LaunchPlan& plan, const std::string& path);
+
+/**
+ * Read a plan written by write_launch_plan. Returns nothing if the file is
+ * missing, unreadable or was built from a database with a different hash.
+ */
+std::optional<LaunchPlan> read_launch_plan(const std::string& path, const std::string& expected_hash);
+
+} // namespace dunedaq::appmodel
+
+#endif // APPMODEL_LAUNCHPLAN_HPP
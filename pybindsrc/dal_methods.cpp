@@ -15,6 +15,7 @@
 
 #include "appmodel/DFApplication.hpp"
 #include "appmodel/DFOApplication.hpp"
+#include "appmodel/GenerationDependencies.hpp"
 #include "appmodel/ReadoutApplication.hpp"
 #include "appmodel/TriggerApplication.hpp"
 #include "appmodel/FakeHSIApplication.hpp"
@@ -84,6 +85,31 @@ register_dal_methods(py::module& m)
   m.def("mlt_application_generate", &application_generate_template<MLTApplication>, "Generate DaqModules required by MLTApplication");
   m.def("wiec_application_generate", &application_generate_template<WIECApplication>, "Generate DaqModules required by WIECApplication");
 
+  py::class_<GenerationDependencies>(m, "GenerationDependencies")
+    .def(py::init<>())
+    .def("generate",
+         [](GenerationDependencies& self,
+            const conffwk::Configuration& confdb,
+            const std::string& dbfile,
+            const std::string& app_id,
+            const std::string& session_id) {
+           auto db = const_cast<conffwk::Configuration*>(&confdb);
+           std::vector<ObjectLocator> mods;
+           for (auto mod : self.generate(db,
+                                         dbfile,
+                                         db->get<confmodel::Session>(session_id),
+                                         db->get<SmartDaqApplication>(app_id))) {
+             mods.push_back({ mod->UID(), mod->class_name() });
+           }
+           return mods;
+         },
+         "Generate the DaqModules of an application, recording the dependencies of the generated objects")
+    .def("sources_of", &GenerationDependencies::sources_of, "Objects (uid@class) a generated object depends on")
+    .def("affected_by", &GenerationDependencies::affected_by, "Generated objects depending on an object (uid@class)")
+    .def("applications_affected_by", &GenerationDependencies::applications_affected_by, "Applications with generated objects depending on an object (uid@class)")
+    .def("dependencies", &GenerationDependencies::dependencies, "Map of generated object to the objects it depends on")
+    ;
+
   m.def("smart_daq_application_construct_commandline_parameters", &smart_daq_application_construct_commandline_parameters, "Get a version of the command line agruments parsed");
 }
 
@@ -0,0 +1,50 @@
+#ifndef CANONICALORDER_HPP
+#define CANONICALORDER_HPP
+
+#include "confmodel/Application.hpp"
+#include "confmodel/Session.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+/**
+ * The objects sorted by UID. Generators iterate over these instead of the
+ * order objects happen to have in the database, so that their output does
+ * not change when a database is rewritten or its segments are reordered.
+ */
+template<typename T>
+inline std::vector<const T*>
+sorted_by_uid(std::vector<const T*> objs)
+{
+  std::sort(objs.begin(), objs.end(), [](const T* a, const T* b) { return a->UID() < b->UID(); });
+  return objs;
+}
+
+/**
+ * The streams sorted by source id, the order in which readout queues and
+ * handlers are created and in which other generators list the streams
+ */
+template<typename T>
+inline std::vector<const T*>
+sorted_by_source_id(std::vector<const T*> streams)
+{
+  std::sort(streams.begin(), streams.end(), [](const T* a, const T* b) {
+    return a->get_source_id() < b->get_source_id();
+  });
+  return streams;
+}
+
+/**
+ * Enabled applications of the session, sorted by UID
+ */
+inline std::vector<const confmodel::Application*>
+enabled_applications(const confmodel::Session* session)
+{
+  return sorted_by_uid(session->get_enabled_applications());
+}
+
+} // namespace dunedaq::appmodel
+
+#endif // CANONICALORDER_HPP
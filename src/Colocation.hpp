@@ -0,0 +1,328 @@
+#ifndef COLOCATION_HPP
+#define COLOCATION_HPP
+
+#include "CanonicalOrder.hpp"
+#include "ConfigObjectArena.hpp"
+#include "RuleIndex.hpp"
+
+#include "appmodel/DFApplication.hpp"
+#include "appmodel/FakeDataApplication.hpp"
+#include "appmodel/GenerationDependencies.hpp"
+#include "appmodel/NetworkConnectionDescriptor.hpp"
+#include "appmodel/NetworkConnectionRule.hpp"
+#include "appmodel/ReadoutApplication.hpp"
+#include "appmodel/SourceIDConf.hpp"
+#include "appmodel/TPStreamWriterApplication.hpp"
+#include "appmodel/TriggerApplication.hpp"
+
+#include "confmodel/DetectorStream.hpp"
+#include "confmodel/DetectorToDaqConnection.hpp"
+#include "confmodel/PhysicalHost.hpp"
+#include "confmodel/Service.hpp"
+#include "confmodel/Session.hpp"
+#include "confmodel/VirtualHost.hpp"
+
+#include <algorithm>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+/**
+ * UID of the physical host an application runs on, or an empty string
+ * if this is not configured.
+ */
+inline std::string
+physical_host_uid(const confmodel::Application* app)
+{
+  auto vhost = app->get_runs_on();
+  if (vhost == nullptr || vhost->get_runs_on() == nullptr) {
+    return "";
+  }
+  return vhost->get_runs_on()->UID();
+}
+
+/**
+ * True if app and all of peers run on the same, known, physical host
+ */
+inline bool
+colocated(const confmodel::Application* app, const std::vector<const confmodel::Application*>& peers)
+{
+  auto host = physical_host_uid(app);
+  if (host.empty() || peers.empty()) {
+    return false;
+  }
+  for (auto peer : peers) {
+    if (physical_host_uid(peer) != host) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Enabled DFApplications of the session, i.e. the senders of DataRequests
+ */
+inline std::vector<const confmodel::Application*>
+dataflow_applications(const confmodel::Session* session)
+{
+  std::vector<const confmodel::Application*> apps;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    if (app->cast<DFApplication>() != nullptr) {
+      apps.push_back(app);
+    }
+  }
+  return apps;
+}
+
+/**
+ * Enabled applications of the session that answer DataRequests with
+ * Fragments, selected as DFApplication does when building the TRB
+ * request connections
+ */
+inline std::vector<const confmodel::Application*>
+data_source_applications(const confmodel::Session* session)
+{
+  std::vector<const confmodel::Application*> apps;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto smartapp = app->cast<SmartDaqApplication>();
+    if (smartapp == nullptr || app->cast<DFApplication>() != nullptr) {
+      continue;
+    }
+    if (app->cast<ReadoutApplication>() == nullptr && app->cast<FakeDataApplication>() == nullptr &&
+        smartapp->get_source_id() == nullptr) {
+      continue;
+    }
+    for (auto rule : smartapp->get_network_rules()) {
+      if (rule->get_descriptor()->get_data_type() == "DataRequest") {
+        apps.push_back(app);
+        break;
+      }
+    }
+  }
+  return apps;
+}
+
+/**
+ * OKS class of a point-to-point connection received by app: a
+ * SharedMemoryConnection if the descriptor allows it and all senders run on
+ * the same host as app, otherwise the network transport of the descriptor.
+ * Both ends must call this with the same arguments to agree on the class.
+ */
+inline std::string
+network_connection_class(const NetworkConnectionDescriptor* desc,
+                         const confmodel::Application* app,
+                         const std::vector<const confmodel::Application*>& senders)
+{
+  if (desc->get_allow_shared_memory() && desc->get_connection_type() == "kSendRecv" && colocated(app, senders)) {
+    return "SharedMemoryConnection";
+  }
+  return desc->connection_class();
+}
+
+/**
+ * OKS class of the DataRequest connection into a data source application
+ */
+inline std::string
+data_request_connection_class(const NetworkConnectionDescriptor* desc,
+                              const confmodel::Application* app,
+                              const confmodel::Session* session)
+{
+  return network_connection_class(desc, app, dataflow_applications(session));
+}
+
+/**
+ * True if the Fragments sender sends to dfapp go over a SharedMemoryConnection
+ * of their own: the descriptor allows it and sender runs on the host of
+ * dfapp. The decision is made for each sender, so that the data sources
+ * sharing the host of a DFApplication use shared memory while the others
+ * keep the network connection.
+ */
+inline bool
+fragments_over_shared_memory(const NetworkConnectionDescriptor* desc,
+                             const confmodel::Application* dfapp,
+                             const confmodel::Application* sender)
+{
+  return desc->get_allow_shared_memory() && desc->get_connection_type() == "kSendRecv" && colocated(dfapp, { sender });
+}
+
+/**
+ * UID of the Fragment connection from sender to dfapp: <uid_base><dfapp>
+ * over the network, <uid_base><dfapp>-<sender> over shared memory
+ */
+inline std::string
+fragment_connection_uid(const NetworkConnectionDescriptor* desc,
+                        const confmodel::Application* dfapp,
+                        const confmodel::Application* sender)
+{
+  std::string uid(desc->get_uid_base() + dfapp->UID());
+  return fragments_over_shared_memory(desc, dfapp, sender) ? uid + "-" + sender->UID() : uid;
+}
+
+/**
+ * Enabled applications of the session subscribing to the data_type
+ * publication uid, i.e. with a subscription on data_type whose uid_base is
+ * a prefix of uid: TPStreamWriterApplications, and TriggerApplications
+ * through their DataSubscriberModule
+ */
+inline std::vector<const confmodel::Application*>
+subscriber_applications(const confmodel::Session* session, const std::string& data_type, const std::string& uid)
+{
+  std::vector<const confmodel::Application*> apps;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    bool tpwriter = app->cast<TPStreamWriterApplication>() != nullptr;
+    if (!tpwriter && app->cast<TriggerApplication>() == nullptr) {
+      continue;
+    }
+    for (auto rule : app->cast<SmartDaqApplication>()->get_network_rules()) {
+      auto desc = rule->get_descriptor();
+      if (desc->get_data_type() == data_type && (tpwriter || rule->get_endpoint_class() == "DataSubscriberModule") &&
+          uid.compare(0, desc->get_uid_base().size(), desc->get_uid_base()) == 0) {
+        apps.push_back(app);
+        break;
+      }
+    }
+  }
+  return apps;
+}
+
+/**
+ * OKS class of the pub/sub connection uid published by app: a
+ * SharedMemoryConnection if the descriptor allows it and every subscriber
+ * runs on the same host as app, otherwise the transport of the descriptor.
+ * The decision is made for each publisher; subscribers find it through
+ * shared_memory_subscriptions.
+ */
+inline std::string
+publication_connection_class(const NetworkConnectionDescriptor* desc,
+                             const confmodel::Application* app,
+                             const std::string& uid,
+                             const confmodel::Session* session)
+{
+  if (desc->get_allow_shared_memory() && desc->get_connection_type() == "kPubSub" &&
+      colocated(app, subscriber_applications(session, desc->get_data_type(), uid))) {
+    return "SharedMemoryConnection";
+  }
+  return desc->connection_class();
+}
+
+/**
+ * SharedMemoryConnections for the data_type publications of the TP handlers
+ * of the session (<uid_base>tphandler-<sid>, see ReadoutApplication) that
+ * go over shared memory and match the subscription pattern, created in
+ * dbfile. The pattern subscription is kept for the publishers that stay on
+ * the network.
+ */
+inline std::vector<const conffwk::ConfigObject*>
+shared_memory_subscriptions(conffwk::Configuration* confdb,
+                            const std::string& dbfile,
+                            const confmodel::Session* session,
+                            const std::string& data_type,
+                            const std::string& subscription,
+                            ConfigObjectArena& objs)
+{
+  std::vector<const conffwk::ConfigObject*> connections;
+  std::regex pattern(subscription);
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto roapp = app->cast<ReadoutApplication>();
+    if (roapp == nullptr || !roapp->get_tp_generation_enabled()) {
+      continue;
+    }
+    auto desc = RuleIndex(roapp).network(data_type);
+    if (desc == nullptr) {
+      continue;
+    }
+    for (auto sid : roapp->get_tp_source_ids()) {
+      std::string uid(desc->get_uid_base() + "tphandler-" + std::to_string(sid->get_sid()));
+      if (!std::regex_match(uid, pattern) ||
+          publication_connection_class(desc, roapp, uid, session) != "SharedMemoryConnection") {
+        continue;
+      }
+      auto& obj = objs.create(confdb, dbfile, "SharedMemoryConnection", uid);
+      obj.set_by_val<std::string>("data_type", desc->get_data_type());
+      obj.set_by_val<std::string>("connection_type", desc->get_connection_type());
+      auto service_obj = desc->get_associated_service()->config_object();
+      obj.set_obj("associated_service", &service_obj);
+      connections.push_back(&obj);
+    }
+  }
+  return connections;
+}
+
+/**
+ * Source ids of the detector streams read out by a ReadoutApplication, in
+ * ascending order
+ */
+inline std::vector<uint32_t>
+readout_stream_source_ids(const ReadoutApplication* roapp)
+{
+  std::vector<uint32_t> source_ids;
+  for (auto d2d_conn_res : roapp->get_contains()) {
+    auto d2d_conn = d2d_conn_res->cast<confmodel::DetectorToDaqConnection>();
+    if (!d2d_conn) {
+      continue;
+    }
+    for (auto dros : d2d_conn->get_streams()) {
+      auto stream = dros->cast<confmodel::DetectorStream>();
+      if (stream) {
+        source_ids.push_back(stream->get_source_id());
+      }
+    }
+  }
+  std::sort(source_ids.begin(), source_ids.end());
+  return source_ids;
+}
+
+/**
+ * ReadoutApplications of the session that share one DataRequest
+ * concentrator, keyed by physical host. Only applications with
+ * request_concentration set take part, and only hosts with at least two
+ * of them form a group. Applications in a group are sorted by UID; the
+ * first one hosts the RequestConcentratorModule.
+ */
+inline std::map<std::string, std::vector<const ReadoutApplication*>>
+request_concentration_groups(const confmodel::Session* session)
+{
+  std::map<std::string, std::vector<const ReadoutApplication*>> groups;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto roapp = app->cast<ReadoutApplication>();
+    if (roapp == nullptr || !roapp->get_request_concentration()) {
+      continue;
+    }
+    auto host = physical_host_uid(roapp);
+    if (host.empty()) {
+      continue;
+    }
+    groups[host].push_back(roapp);
+  }
+
+  for (auto it = groups.begin(); it != groups.end();) {
+    if (it->second.size() < 2) {
+      it = groups.erase(it);
+      continue;
+    }
+    std::sort(it->second.begin(), it->second.end(), [](auto a, auto b) { return a->UID() < b->UID(); });
+    ++it;
+  }
+  return groups;
+}
+
+/**
+ * Suffix appended to the DataRequest descriptor uid_base for the
+ * connection into the concentrator of a host
+ */
+inline std::string
+concentrator_connection_suffix(const std::string& host_uid)
+{
+  return "concentrator-" + host_uid;
+}
+
+} // namespace dunedaq::appmodel
+#endif // COLOCATION_HPP
@@ -0,0 +1,44 @@
+#ifndef CONFIGOBJECTARENA_HPP
+#define CONFIGOBJECTARENA_HPP
+
+#include "conffwk/ConfigObject.hpp"
+#include "conffwk/Configuration.hpp"
+
+#include <deque>
+#include <string>
+
+namespace dunedaq::appmodel {
+
+/**
+ * Owner of the ConfigObject handles a generator creates while wiring
+ * objects together. The handles keep their address until the arena goes
+ * out of scope, so pointers to them can be passed to set_obj/set_objs at
+ * any time, and they are allocated and released in blocks rather than one
+ * by one. The database objects themselves are not affected by the release.
+ */
+class ConfigObjectArena
+{
+public:
+  // A new object of class class_name created in dbfile
+  conffwk::ConfigObject& create(conffwk::Configuration* confdb,
+                                const std::string& dbfile,
+                                const std::string& class_name,
+                                const std::string& uid)
+  {
+    auto& obj = m_objects.emplace_back();
+    confdb->create(dbfile, class_name, uid, obj);
+    return obj;
+  }
+
+  // Keeps a handle to an object created elsewhere
+  conffwk::ConfigObject& add(const conffwk::ConfigObject& obj) { return m_objects.emplace_back(obj); }
+
+  size_t size() const { return m_objects.size(); }
+
+private:
+  std::deque<conffwk::ConfigObject> m_objects;
+};
+
+} // namespace dunedaq::appmodel
+
+#endif // CONFIGOBJECTARENA_HPP
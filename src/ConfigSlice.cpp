@@ -0,0 +1,283 @@
+/**
+ * @file ConfigSlice.cpp
+ *
+ * Computation and writing of per-application database slices
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "appmodel/ConfigSlice.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include "confmodel/RCApplication.hpp"
+#include "confmodel/Segment.hpp"
+#include "logging/Logging.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+namespace dunedaq::appmodel {
+
+namespace {
+
+bool
+is_a(conffwk::Configuration& confdb, const std::string& class_name, const std::string& base)
+{
+  if (class_name == base) {
+    return true;
+  }
+  auto& supers = confdb.get_class_info(class_name).p_superclasses;
+  return std::find(supers.begin(), supers.end(), base) != supers.end();
+}
+
+bool
+stopped(conffwk::Configuration& confdb,
+        const std::string& class_name,
+        const std::string& relationship,
+        const std::set<std::string>& stop)
+{
+  for (auto& entry : stop) {
+    auto dot = entry.find('.');
+    if (entry.substr(dot + 1) == relationship && is_a(confdb, class_name, entry.substr(0, dot))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<conffwk::ConfigObject>
+related_objects(conffwk::ConfigObject& obj, const conffwk::relationship_t& rel)
+{
+  std::vector<conffwk::ConfigObject> related;
+  if (rel.p_cardinality == conffwk::zero_or_many || rel.p_cardinality == conffwk::one_or_many) {
+    obj.get(rel.p_name, related);
+  }
+  else {
+    conffwk::ConfigObject single;
+    obj.get(rel.p_name, single);
+    if (!single.is_null()) {
+      related.push_back(single);
+    }
+  }
+  return related;
+}
+
+// Segments from the top segment of the session down to the one holding app
+bool
+segment_path(const confmodel::Segment* segment,
+             const confmodel::Application* app,
+             std::vector<const confmodel::Segment*>& path)
+{
+  path.push_back(segment);
+  auto apps = segment->get_applications();
+  if (segment->get_controller()->UID() == app->UID() ||
+      std::any_of(apps.begin(), apps.end(), [app](auto a) { return a->UID() == app->UID(); })) {
+    return true;
+  }
+  for (auto seg : segment->get_segments()) {
+    if (segment_path(seg, app, path)) {
+      return true;
+    }
+  }
+  path.pop_back();
+  return false;
+}
+
+template<typename T>
+void
+copy_value(conffwk::ConfigObject& from, conffwk::ConfigObject& to, const conffwk::attribute_t& attr)
+{
+  if (attr.p_is_multi_value) {
+    std::vector<T> values;
+    from.get(attr.p_name, values);
+    to.set_by_val<std::vector<T>>(attr.p_name, values);
+  }
+  else {
+    T value;
+    from.get(attr.p_name, value);
+    to.set_by_val<T>(attr.p_name, value);
+  }
+}
+
+// enum, class, date and time attributes are strings with their own setters
+void
+copy_string_attribute(conffwk::ConfigObject& from,
+                      conffwk::ConfigObject& to,
+                      const conffwk::attribute_t& attr,
+                      void (conffwk::ConfigObject::*set)(const std::string&, const std::string&),
+                      void (conffwk::ConfigObject::*set_multi)(const std::string&, const std::vector<std::string>&))
+{
+  if (attr.p_is_multi_value) {
+    std::vector<std::string> values;
+    from.get(attr.p_name, values);
+    (to.*set_multi)(attr.p_name, values);
+  }
+  else {
+    std::string value;
+    from.get(attr.p_name, value);
+    (to.*set)(attr.p_name, value);
+  }
+}
+
+void
+copy_attribute(conffwk::ConfigObject& from, conffwk::ConfigObject& to, const conffwk::attribute_t& attr)
+{
+  using Set = void (conffwk::ConfigObject::*)(const std::string&, const std::string&);
+  using SetMulti = void (conffwk::ConfigObject::*)(const std::string&, const std::vector<std::string>&);
+  switch (attr.p_type) {
+    case conffwk::bool_type: copy_value<bool>(from, to, attr); break;
+    case conffwk::s8_type: copy_value<int8_t>(from, to, attr); break;
+    case conffwk::u8_type: copy_value<uint8_t>(from, to, attr); break;
+    case conffwk::s16_type: copy_value<int16_t>(from, to, attr); break;
+    case conffwk::u16_type: copy_value<uint16_t>(from, to, attr); break;
+    case conffwk::s32_type: copy_value<int32_t>(from, to, attr); break;
+    case conffwk::u32_type: copy_value<uint32_t>(from, to, attr); break;
+    case conffwk::s64_type: copy_value<int64_t>(from, to, attr); break;
+    case conffwk::u64_type: copy_value<uint64_t>(from, to, attr); break;
+    case conffwk::float_type: copy_value<float>(from, to, attr); break;
+    case conffwk::double_type: copy_value<double>(from, to, attr); break;
+    case conffwk::string_type: copy_value<std::string>(from, to, attr); break;
+    case conffwk::enum_type:
+      copy_string_attribute(from, to, attr, static_cast<Set>(&conffwk::ConfigObject::set_enum),
+                            static_cast<SetMulti>(&conffwk::ConfigObject::set_enum));
+      break;
+    case conffwk::class_type:
+      copy_string_attribute(from, to, attr, static_cast<Set>(&conffwk::ConfigObject::set_class),
+                            static_cast<SetMulti>(&conffwk::ConfigObject::set_class));
+      break;
+    case conffwk::date_type:
+      copy_string_attribute(from, to, attr, static_cast<Set>(&conffwk::ConfigObject::set_date),
+                            static_cast<SetMulti>(&conffwk::ConfigObject::set_date));
+      break;
+    case conffwk::time_type:
+      copy_string_attribute(from, to, attr, static_cast<Set>(&conffwk::ConfigObject::set_time),
+                            static_cast<SetMulti>(&conffwk::ConfigObject::set_time));
+      break;
+  }
+}
+
+} // namespace
+
+std::vector<conffwk::ConfigObject>
+reference_closure(conffwk::Configuration& confdb,
+                  const std::vector<conffwk::ConfigObject>& roots,
+                  const std::set<std::string>& stop)
+{
+  std::vector<conffwk::ConfigObject> closure;
+  std::set<std::string> seen;
+  std::deque<conffwk::ConfigObject> pending;
+  for (auto& root : roots) {
+    if (seen.insert(root.full_name()).second) {
+      pending.push_back(root);
+    }
+  }
+
+  while (!pending.empty()) {
+    auto obj = pending.front();
+    pending.pop_front();
+    closure.push_back(obj);
+    for (auto& rel : confdb.get_class_info(obj.class_name()).p_relationships) {
+      if (stopped(confdb, obj.class_name(), rel.p_name, stop)) {
+        continue;
+      }
+      for (auto& related : related_objects(obj, rel)) {
+        if (seen.insert(related.full_name()).second) {
+          pending.push_back(related);
+        }
+      }
+    }
+  }
+  return closure;
+}
+
+std::vector<conffwk::ConfigObject>
+application_slice(conffwk::Configuration& confdb,
+                  const confmodel::Session* session,
+                  const SmartDaqApplication* app,
+                  const std::vector<const confmodel::DaqModule*>& modules)
+{
+  std::vector<const confmodel::Segment*> path;
+  if (!segment_path(session->get_segment(), app, path)) {
+    throw(BadConf(ERS_HERE, "Application " + app->UID() + " is not part of session " + session->UID()));
+  }
+
+  std::vector<conffwk::ConfigObject> roots{ session->config_object(), app->config_object() };
+  for (auto segment : path) {
+    roots.push_back(segment->config_object());
+  }
+  for (auto module : modules) {
+    roots.push_back(module->config_object());
+  }
+
+  // The other applications of the session are only reachable through the
+  // segment tree, whose relevant part is already in the roots
+  auto slice = reference_closure(confdb, roots, { "Segment.segments", "Segment.applications" });
+  TLOG_DEBUG(5) << "Slice of " << app->UID() << " has " << slice.size() << " objects";
+  return slice;
+}
+
+void
+write_application_slice(conffwk::Configuration& confdb,
+                        const std::vector<conffwk::ConfigObject>& objects,
+                        const SmartDaqApplication* app,
+                        const std::vector<const confmodel::DaqModule*>& modules,
+                        const std::string& database_hash,
+                        const std::vector<std::string>& database_files,
+                        const std::string& slice_file,
+                        const std::list<std::string>& schema_files)
+{
+  conffwk::Configuration slicedb("oksconflibs");
+  slicedb.create(slice_file, schema_files);
+
+  // Create all the objects first so that relationships can be set in any order
+  std::map<std::string, conffwk::ConfigObject> copies;
+  for (auto obj : objects) {
+    auto& copy = copies[obj.full_name()];
+    slicedb.create(slice_file, obj.class_name(), obj.UID(), copy);
+    for (auto& attr : confdb.get_class_info(obj.class_name()).p_attributes) {
+      copy_attribute(obj, copy, attr);
+    }
+  }
+
+  for (auto obj : objects) {
+    auto& copy = copies[obj.full_name()];
+    bool segment = is_a(confdb, obj.class_name(), "Segment");
+    for (auto& rel : confdb.get_class_info(obj.class_name()).p_relationships) {
+      std::vector<const conffwk::ConfigObject*> targets;
+      for (auto& related : related_objects(obj, rel)) {
+        auto it = copies.find(related.full_name());
+        if (it != copies.end()) {
+          targets.push_back(&it->second);
+        }
+        else if (!segment || (rel.p_name != "segments" && rel.p_name != "applications")) {
+          throw(BadConf(ERS_HERE,
+                        "Object " + related.full_name() + " referenced by " + obj.full_name() + " is not in the slice"));
+        }
+      }
+      if (rel.p_cardinality == conffwk::zero_or_many || rel.p_cardinality == conffwk::one_or_many) {
+        copy.set_objs(rel.p_name, targets);
+      }
+      else if (!targets.empty()) {
+        copy.set_obj(rel.p_name, targets.front());
+      }
+    }
+  }
+
+  std::vector<const conffwk::ConfigObject*> module_copies;
+  for (auto module : modules) {
+    module_copies.push_back(&copies[module->config_object().full_name()]);
+  }
+  conffwk::ConfigObject frozen_obj;
+  slicedb.create(slice_file, "FrozenModuleSet", "frozen-" + app->UID(), frozen_obj);
+  frozen_obj.set_by_val<std::string>("database_hash", database_hash);
+  frozen_obj.set_by_val<std::vector<std::string>>("database_files", database_files);
+  frozen_obj.set_obj("application", &copies[app->config_object().full_name()]);
+  frozen_obj.set_objs("modules", module_copies);
+
+  slicedb.commit("Configuration slice of " + app->UID());
+}
+
+} // namespace dunedaq::appmodel
@@ -0,0 +1,35 @@
+/**
+ * @file ConnectionDescriptors.cpp
+ *
+ * Implementation of the dal methods of QueueDescriptor and
+ * NetworkConnectionDescriptor
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "appmodel/NetworkConnectionDescriptor.hpp"
+#include "appmodel/QueueDescriptor.hpp"
+
+#include <string>
+
+using namespace dunedaq::appmodel;
+
+std::string
+QueueDescriptor::connection_class() const
+{
+  if (get_transfer_mode() == "kOwnershipTransfer") {
+    return "OwnershipTransferQueue";
+  }
+  return "Queue";
+}
+
+std::string
+NetworkConnectionDescriptor::connection_class() const
+{
+  if (get_transfer_mode() == "kZeroCopy") {
+    return "ZeroCopyNetworkConnection";
+  }
+  return "NetworkConnection";
+}
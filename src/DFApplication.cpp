@@ -8,15 +8,21 @@
  * received with this code.
  */
 
+#include "Colocation.hpp"
+#include "ConfigObjectArena.hpp"
+#include "HDF5WriteTuning.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
 
 #include "appmodel/DFApplication.hpp"
+#include "appmodel/DFHWConf.hpp"
 #include "appmodel/DataStoreConf.hpp"
 #include "appmodel/DataWriterConf.hpp"
 #include "appmodel/DataWriterModule.hpp"
 #include "appmodel/FakeDataApplication.hpp"
 #include "appmodel/FakeDataProdConf.hpp"
 #include "appmodel/FilenameParams.hpp"
+#include "appmodel/GenerationDependencies.hpp"
 #include "appmodel/NetworkConnectionDescriptor.hpp"
 #include "appmodel/NetworkConnectionRule.hpp"
 #include "appmodel/QueueConnectionRule.hpp"
@@ -59,6 +65,32 @@ fill_queue_object_from_desc(const QueueDescriptor* qDesc, conffwk::ConfigObject&
   qObj.set_by_val<uint32_t>("capacity", qDesc->get_capacity());
 }
 
+// Validates the asynchronous write settings of a DataWriterConf and returns
+// the number of TriggerRecords the writer can have in flight
+inline uint32_t
+check_async_write(const DataWriterConf* dwrConf)
+{
+  auto inflight = dwrConf->get_max_inflight_records();
+  auto threads = dwrConf->get_writer_threads();
+  if (inflight == 0 || threads == 0) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("DataWriterConf {} needs at least one in-flight record and one writer thread",
+                              dwrConf->UID())));
+  }
+  if (threads > inflight) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("DataWriterConf {} has {} writer threads for only {} in-flight records",
+                              dwrConf->UID(),
+                              threads,
+                              inflight)));
+  }
+  if (dwrConf->get_flush_policy() == "kInterval" && dwrConf->get_flush_interval_ms() == 0) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("DataWriterConf {} uses flush_policy kInterval with no interval", dwrConf->UID())));
+  }
+  return inflight;
+}
+
 inline void
 fill_netconn_object_from_desc(const NetworkConnectionDescriptor* netDesc, conffwk::ConfigObject& netObj)
 {
@@ -79,52 +111,30 @@ fill_sourceid_object_from_app(const SmartDaqApplication* smartapp,
 }
 
 inline void
-fill_sourceid_object_from_app(conffwk::Configuration* confdb,
-                              const std::string& dbfile,
-                              const ReadoutApplication* roapp,
-                              const conffwk::ConfigObject* netConn,
-                              conffwk::ConfigObject& sidNetObj,
-                              std::vector<std::shared_ptr<conffwk::ConfigObject>> sidObjs)
+fill_sourceid_object_from_apps(conffwk::Configuration* confdb,
+                               const std::string& dbfile,
+                               const std::vector<const ReadoutApplication*>& roapps,
+                               const conffwk::ConfigObject* netConn,
+                               conffwk::ConfigObject& sidNetObj,
+                               ConfigObjectArena& sidObjs)
 {
   sidNetObj.set_obj("netconn", netConn);
 
   std::vector<const conffwk::ConfigObject*> source_id_objs;
-  std::vector<uint32_t> app_source_ids;
-
-  for (auto d2d_conn_res : roapp->get_contains()) {
 
-    // get the readout groups and the interfaces and streams therein; 1 reaout group corresponds to 1 data reader
-    // module
-    auto d2d_conn = d2d_conn_res->cast<confmodel::DetectorToDaqConnection>();
-
-    if (!d2d_conn) {
-      continue;
+  for (auto roapp : roapps) {
+    for (auto& source_id : readout_stream_source_ids(roapp)) {
+      std::string streamSidUid(roapp->UID() + "SourceIDConf" + std::to_string(source_id));
+      auto& stream_sid_obj = sidObjs.create(confdb, dbfile, "SourceIDConf", streamSidUid);
+      stream_sid_obj.set_by_val<uint32_t>("sid", source_id);
+      stream_sid_obj.set_by_val<std::string>("subsystem", "Detector_Readout");
+      source_id_objs.push_back(&stream_sid_obj);
     }
 
-    // Loop over senders
-    for (auto dros : d2d_conn->get_streams()) {
-
-      auto stream = dros->cast<confmodel::DetectorStream>();
-      if (!stream)
-        continue;
-      app_source_ids.push_back(stream->get_source_id());
+    for (auto tp_sid : roapp->get_tp_source_ids()) {
+      source_id_objs.push_back(&tp_sid->config_object());
     }
   }
-
-  for (auto& source_id : app_source_ids) {
-    auto stream_sid_obj = std::make_shared<conffwk::ConfigObject>();
-    std::string streamSidUid(roapp->UID() + "SourceIDConf" + std::to_string(source_id));
-    confdb->create(dbfile, "SourceIDConf", streamSidUid, *stream_sid_obj);
-    stream_sid_obj->set_by_val<uint32_t>("sid", source_id);
-    stream_sid_obj->set_by_val<std::string>("subsystem", "Detector_Readout");
-    sidObjs.push_back(stream_sid_obj);
-    source_id_objs.push_back(sidObjs.back().get());
-  }
-
-  for (auto tp_sid : roapp->get_tp_source_ids()) {
-    sidObjs.push_back(std::make_shared<conffwk::ConfigObject>(tp_sid->config_object()));
-    source_id_objs.push_back(sidObjs.back().get());
-  }
   /*
   auto trig_sid_obj = std::make_shared<conffwk::ConfigObject>();
   std::string trgSidUid(roapp->UID() + "TRGSourceIDConf" + std::to_string(roapp->get_tp_source_id()));
@@ -137,13 +147,24 @@ fill_sourceid_object_from_app(conffwk::Configuration* confdb,
   sidNetObj.set_objs("source_ids", source_id_objs);
 }
 
+inline void
+fill_sourceid_object_from_app(conffwk::Configuration* confdb,
+                              const std::string& dbfile,
+                              const ReadoutApplication* roapp,
+                              const conffwk::ConfigObject* netConn,
+                              conffwk::ConfigObject& sidNetObj,
+                              ConfigObjectArena& sidObjs)
+{
+  fill_sourceid_object_from_apps(confdb, dbfile, { roapp }, netConn, sidNetObj, sidObjs);
+}
+
 inline void
 fill_sourceid_object_from_app(conffwk::Configuration* confdb,
                               const std::string& dbfile,
                               const FakeDataApplication* fdapp,
                               const conffwk::ConfigObject* netConn,
                               conffwk::ConfigObject& sidNetObj,
-                              std::vector<std::shared_ptr<conffwk::ConfigObject>> sidObjs)
+                              ConfigObjectArena& sidObjs)
 {
   sidNetObj.set_obj("netconn", netConn);
 
@@ -160,17 +181,18 @@ fill_sourceid_object_from_app(conffwk::Configuration* confdb,
       continue;
     }
 
-    app_source_ids.push_back(fdpc->get_source_id());
+    for (auto source_id : fdpc->source_ids()) {
+      app_source_ids.push_back(source_id);
+    }
   }
 
+  std::sort(app_source_ids.begin(), app_source_ids.end());
   for (auto& source_id : app_source_ids) {
-    auto stream_sid_obj = std::make_shared<conffwk::ConfigObject>();
     std::string streamSidUid(fdapp->UID() + "SourceIDConf" + std::to_string(source_id));
-    confdb->create(dbfile, "SourceIDConf", streamSidUid, *stream_sid_obj);
-    stream_sid_obj->set_by_val<uint32_t>("sid", source_id);
-    stream_sid_obj->set_by_val<std::string>("subsystem", "Detector_Readout");
-    sidObjs.push_back(stream_sid_obj);
-    source_id_objs.push_back(sidObjs.back().get());
+    auto& stream_sid_obj = sidObjs.create(confdb, dbfile, "SourceIDConf", streamSidUid);
+    stream_sid_obj.set_by_val<uint32_t>("sid", source_id);
+    stream_sid_obj.set_by_val<std::string>("subsystem", "Detector_Readout");
+    source_id_objs.push_back(&stream_sid_obj);
   }
 
   sidNetObj.set_objs("source_ids", source_id_objs);
@@ -181,6 +203,10 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
                                 const std::string& dbfile,
                                 const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   // Containers for module specific config objects for output/input
@@ -190,40 +216,35 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
 
   // -- First, we process expected Queue and Network connections and create their objects.
 
-  // Process the queue rules looking for the TriggerRecord queue between TRB and DataWriterModule
-  const QueueDescriptor* trQDesc = nullptr;
-  for (auto rule : get_queue_rules()) {
-    auto destination_class = rule->get_destination_class();
-    if (destination_class == "DataWriterModule") {
-      trQDesc = rule->get_descriptor();
-    }
-  }
+  RuleIndex rules(this);
+
+  // The TriggerRecord queue between TRB and DataWriterModule
+  const QueueDescriptor* trQDesc = rules.queue_to("DataWriterModule");
   if (trQDesc == nullptr) { // BadConf if no descriptor between TRB and DataWriterModule
     throw(BadConf(ERS_HERE, "Could not find queue descriptor rule for TriggerRecords!"));
   }
   // Create queue connection config object
   conffwk::ConfigObject trQueueObj;
   std::string trQueueUid(trQDesc->get_uid_base() + UID());
-  confdb->create(dbfile, "Queue", trQueueUid, trQueueObj);
+  confdb->create(dbfile, trQDesc->connection_class(), trQueueUid, trQueueObj);
   fill_queue_object_from_desc(trQDesc, trQueueObj);
+  // Records held by asynchronous writers are not in the queue, so leave
+  // room for all of them to be refilled without blocking the TRB
+  uint32_t inflightRecords = 0;
+  for (auto dwrConf : get_data_writers()) {
+    inflightRecords += check_async_write(dwrConf);
+  }
+  if (inflightRecords > trQDesc->get_capacity()) {
+    TLOG_DEBUG(7) << "Raising capacity of " << trQueueUid << " to " << inflightRecords << " in-flight records";
+    trQueueObj.set_by_val<uint32_t>("capacity", inflightRecords);
+  }
   // Place trigger record queue object into vector of output objs of TRB module
   trbOutputObjs.push_back(&trQueueObj);
 
-  // Process the network rules looking for the Fragments and TriggerDecision inputs for TRB
-  const NetworkConnectionDescriptor* fragNetDesc = nullptr;
-  const NetworkConnectionDescriptor* trigdecNetDesc = nullptr;
-  const NetworkConnectionDescriptor* tokenNetDesc = nullptr;
-  for (auto rule : get_network_rules()) {
-    auto descriptor = rule->get_descriptor();
-    auto data_type = descriptor->get_data_type();
-    if (data_type == "Fragment") {
-      fragNetDesc = rule->get_descriptor();
-    } else if (data_type == "TriggerDecision") {
-      trigdecNetDesc = rule->get_descriptor();
-    } else if (data_type == "TriggerDecisionToken") {
-      tokenNetDesc = rule->get_descriptor();
-    }
-  }
+  // The Fragments and TriggerDecision inputs for TRB
+  const NetworkConnectionDescriptor* fragNetDesc = rules.network("Fragment");
+  const NetworkConnectionDescriptor* trigdecNetDesc = rules.network("TriggerDecision");
+  const NetworkConnectionDescriptor* tokenNetDesc = rules.network("TriggerDecisionToken");
   if (fragNetDesc == nullptr) { // BadConf if no descriptor for Fragments into TRB
     throw(BadConf(ERS_HERE, "Could not find network descriptor rule for input Fragments!"));
   }
@@ -243,7 +264,9 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
   std::string fragNetUid = fragNetDesc->get_uid_base() + UID();
   std::string trigdecNetUid = trigdecNetDesc->get_uid_base() + UID();
   std::string tokenNetUid = tokenNetDesc->get_uid_base();
-  confdb->create(dbfile, "NetworkConnection", fragNetUid, fragNetObj);
+  confdb->create(dbfile, fragNetDesc->connection_class(), fragNetUid, fragNetObj);
+  // TriggerDecisions and tokens are exchanged with the DFO, which creates
+  // them as plain NetworkConnections: only the fragment path is copy-free
   confdb->create(dbfile, "NetworkConnection", trigdecNetUid, trigdecNetObj);
   confdb->create(dbfile, "NetworkConnection", tokenNetUid, tokenNetObj);
   fill_netconn_object_from_desc(fragNetDesc, fragNetObj);
@@ -252,11 +275,15 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
 
   // Process special Network rules!
   // Looking for DataRequest rules from ReadoutAppplications in current Session
-  auto sessionApps = session->get_enabled_applications();
-  std::vector<conffwk::ConfigObject> dreqNetObjs;
-  std::vector<conffwk::ConfigObject> sidNetObjs;
-  std::vector<std::shared_ptr<conffwk::ConfigObject>> sidObjs;
+  auto sessionApps = enabled_applications(session);
+  ConfigObjectArena dreqNetObjs;
+  ConfigObjectArena sidNetObjs;
+  ConfigObjectArena sidObjs;
+  // ReadoutApplications sharing a request concentrator are reached through one
+  // connection per physical host, created when meeting the first app of the group
+  auto concentrationGroups = request_concentration_groups(session);
   for (auto app : sessionApps) {
+    GenerationDependencies::note_read(app);
     auto smartapp = app->cast<appmodel::SmartDaqApplication>();
     auto roapp = app->cast<appmodel::ReadoutApplication>();
     auto fdapp = app->cast<appmodel::FakeDataApplication>();
@@ -272,34 +299,42 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
     for (auto rule : roQRules) {
       auto descriptor = rule->get_descriptor();
       auto data_type = descriptor->get_data_type();
-      if (data_type == "DataRequest") {
+      if (data_type == "DataRequest" && roapp != nullptr && concentrationGroups.count(physical_host_uid(roapp)) &&
+          roapp->get_request_concentration()) {
+        auto host = physical_host_uid(roapp);
+        auto& group = concentrationGroups[host];
+        if (group.front() != roapp) {
+          continue;
+        }
+        std::string dreqNetUid(descriptor->get_uid_base() + concentrator_connection_suffix(host));
+        auto& dreqNetObj = dreqNetObjs.create(confdb, dbfile, descriptor->connection_class(), dreqNetUid);
+        fill_netconn_object_from_desc(descriptor, dreqNetObj);
+        trbOutputObjs.push_back(&dreqNetObj);
+
+        auto& sidNetObj = sidNetObjs.create(confdb, dbfile, "SourceIDToNetworkConnection", dreqNetUid + "-sids");
+        fill_sourceid_object_from_apps(confdb, dbfile, group, &dreqNetObj, sidNetObj, sidObjs);
+        trbSidNetObjs.push_back(&sidNetObj);
+      } else if (data_type == "DataRequest") {
         std::string dreqNetUid(descriptor->get_uid_base() + smartapp->UID());
-        dreqNetObjs.emplace_back();
-        confdb->create(dbfile, "NetworkConnection", dreqNetUid, dreqNetObjs.back());
-        fill_netconn_object_from_desc(descriptor, dreqNetObjs.back());
+        auto& dreqNetObj = dreqNetObjs.create(
+          confdb, dbfile, data_request_connection_class(descriptor, smartapp, session), dreqNetUid);
+        fill_netconn_object_from_desc(descriptor, dreqNetObj);
+        trbOutputObjs.push_back(&dreqNetObj);
 
         std::string sidToNetUid(descriptor->get_uid_base() + smartapp->UID() + "-sids");
-        sidNetObjs.emplace_back();
-        confdb->create(dbfile, "SourceIDToNetworkConnection", sidToNetUid, sidNetObjs.back());
+        auto& sidNetObj = sidNetObjs.create(confdb, dbfile, "SourceIDToNetworkConnection", sidToNetUid);
         if (roapp != nullptr) {
-          fill_sourceid_object_from_app(confdb, dbfile, roapp, &dreqNetObjs.back(), sidNetObjs.back(), sidObjs);
+          fill_sourceid_object_from_app(confdb, dbfile, roapp, &dreqNetObj, sidNetObj, sidObjs);
         } else if (fdapp != nullptr) {
-          fill_sourceid_object_from_app(confdb, dbfile, fdapp, &dreqNetObjs.back(), sidNetObjs.back(), sidObjs);
+          fill_sourceid_object_from_app(confdb, dbfile, fdapp, &dreqNetObj, sidNetObj, sidObjs);
         } else {
-          fill_sourceid_object_from_app(smartapp, &dreqNetObjs.back(), sidNetObjs.back());
+          fill_sourceid_object_from_app(smartapp, &dreqNetObj, sidNetObj);
         }
+        trbSidNetObjs.push_back(&sidNetObj);
       } // If network rule has DataRequest type of data
     }   // Loop over Apps network rules
   }     // loop over Session specific Apps
 
-  // Get pointers to objects here, after vector has been filled so they don't move on us
-  for (auto& obj : dreqNetObjs) {
-    trbOutputObjs.push_back(&obj);
-  }
-  for (auto& obj : sidNetObjs) {
-    trbSidNetObjs.push_back(&obj);
-  }
-
   // -- Second, we create the Module objects and assign their configs, with the precreated
   // -- connection config objects above.
 
@@ -308,6 +343,15 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
   if (trbConf == nullptr) {
     throw(BadConf(ERS_HERE, "No DataWriterModule or TRB configuration given"));
   }
+  if (trbConf->get_data_request_max_batch_size() == 0) {
+    throw(BadConf(ERS_HERE, "TRBConf " + trbConf->UID() + ": data_request_max_batch_size must be at least 1"));
+  }
+  if (trbConf->get_data_request_batch_window_us() != 0 && trbConf->get_trigger_record_timeout_ms() != 0 &&
+      trbConf->get_data_request_batch_window_us() >=
+        static_cast<uint64_t>(trbConf->get_trigger_record_timeout_ms()) * 1000) {
+    throw(BadConf(ERS_HERE,
+                  "TRBConf " + trbConf->UID() + ": data_request_batch_window_us is not shorter than trigger_record_timeout_ms"));
+  }
   auto trbConfObj = trbConf->config_object();
   trbConfObj.set_by_val<uint32_t>("source_id", get_source_id()->get_sid());
   // Prepare TRB Module Object and assign its Config Object.
@@ -315,7 +359,19 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
   std::string trbUid(UID() + "-trb");
   confdb->create(dbfile, "TRBModule", trbUid, trbObj);
   trbObj.set_obj("configuration", &trbConfObj);
-  trbObj.set_objs("inputs", { &trigdecNetObj, &fragNetObj });
+  // Data sources on this host send their Fragments over a shared memory
+  // connection of their own, the others over fragNetObj
+  std::vector<const conffwk::ConfigObject*> trbInputObjs{ &trigdecNetObj, &fragNetObj };
+  ConfigObjectArena fragShmObjs;
+  for (auto app : data_source_applications(session)) {
+    if (fragments_over_shared_memory(fragNetDesc, this, app)) {
+      auto& fragShmObj =
+        fragShmObjs.create(confdb, dbfile, "SharedMemoryConnection", fragment_connection_uid(fragNetDesc, this, app));
+      fill_netconn_object_from_desc(fragNetDesc, fragShmObj);
+      trbInputObjs.push_back(&fragShmObj);
+    }
+  }
+  trbObj.set_objs("inputs", trbInputObjs);
   trbObj.set_objs("outputs", trbOutputObjs);
   trbObj.set_objs("request_connections", trbSidNetObjs);
   // Push TRB Module Object from confdb
@@ -326,6 +382,8 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
   if (dwrConfs.size() == 0) {
     throw(BadConf(ERS_HERE, "No DataWriterModule or TRB configuration given"));
   }
+  bool directIO = get_uses() != nullptr && get_uses()->get_direct_io_supported();
+  uint32_t ioBlockSize = get_uses() != nullptr ? get_uses()->get_io_block_size() : 4096;
   uint dw_idx = 0;
   for (auto dwrConf : dwrConfs) {
     // auto fnParamsObj = dwrConf->get_data_store_params()->get_filename_params()->config_object();
@@ -340,6 +398,11 @@ DFApplication::generate_modules(conffwk::Configuration* confdb,
     dwrObj.set_obj("configuration", &dwrConfObj);
     dwrObj.set_objs("inputs", { &trQueueObj });
     dwrObj.set_objs("outputs", { &tokenNetObj });
+    conffwk::ConfigObject writeParamsObj;
+    if (create_hdf5_write_params(
+          confdb, dbfile, dwrUid, dwrConf->get_data_store_params(), directIO, ioBlockSize, writeParamsObj)) {
+      dwrObj.set_obj("write_params", &writeParamsObj);
+    }
     // Push DataWriterModule Module Object from confdb
     modules.push_back(confdb->get<DataWriterModule>(dwrUid));
     ++dw_idx;
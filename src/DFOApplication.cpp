@@ -8,12 +8,16 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
 #include "ModuleFactory.hpp"
 
 #include "appmodel/DFApplication.hpp"
 #include "appmodel/DFOApplication.hpp"
 #include "appmodel/DFOConf.hpp"
 #include "appmodel/DFOModule.hpp"
+#include "appmodel/DFOTarget.hpp"
+#include "appmodel/GenerationDependencies.hpp"
+#include "appmodel/TRBConf.hpp"
 #include "appmodel/NetworkConnectionDescriptor.hpp"
 #include "appmodel/NetworkConnectionRule.hpp"
 #include "appmodel/QueueConnectionRule.hpp"
@@ -26,6 +30,8 @@
 #include "logging/Logging.hpp"
 #include "oks/kernel.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -41,11 +47,56 @@ static ModuleFactory::Registrator __reg__("DFOApplication",
                                             return app->generate_modules(confdb, dbfile, session);
                                           });
 
+namespace {
+struct DispatchParams
+{
+  int32_t busy;
+  int32_t free;
+  uint32_t weight;
+};
+
+// Scale the nominal thresholds of dfoConf with the number of DataWriters of
+// dfapp, optionally capped by the TriggerRecord data its writers can buffer
+DispatchParams
+tune_dispatch_params(const DFOConf* dfoConf, const DFApplication* dfapp)
+{
+  int64_t n_writers = dfapp->get_data_writers().size();
+  int64_t busy = static_cast<int64_t>(dfoConf->get_busy_threshold()) * n_writers;
+  int64_t hysteresis = static_cast<int64_t>(dfoConf->get_busy_threshold()) - dfoConf->get_free_threshold();
+  if (hysteresis <= 0) {
+    throw(BadConf(ERS_HERE, "DFOConf " + dfoConf->UID() + ": free_threshold must be lower than busy_threshold"));
+  }
+
+  auto tr_size = dfoConf->get_expected_trigger_record_size();
+  auto max_buffered = dfoConf->get_max_buffered_bytes_per_writer();
+  if (tr_size != 0 && max_buffered != 0) {
+    int64_t capacity = static_cast<int64_t>(max_buffered / tr_size) * n_writers;
+    if (capacity < 1) {
+      throw(BadConf(ERS_HERE,
+                    "DFApplication " + dfapp->UID() + " cannot buffer a single TriggerRecord of " +
+                      std::to_string(tr_size) + " bytes"));
+    }
+    busy = std::min(busy, capacity);
+  }
+
+  // Keep the same hysteresis per writer, but never below one free slot
+  int64_t free = std::clamp(busy - hysteresis * n_writers, int64_t(0), busy - 1);
+
+  TLOG_DEBUG(7) << "DFO dispatch parameters for " << dfapp->UID() << ": busy=" << busy << " free=" << free
+                << " weight=" << n_writers;
+  return { static_cast<int32_t>(busy), static_cast<int32_t>(free), static_cast<uint32_t>(n_writers) };
+}
+} // namespace
+
 std::vector<const confmodel::DaqModule*>
 DFOApplication::generate_modules(conffwk::Configuration* confdb,
                                  const std::string& dbfile,
                                  const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   std::string dfoUid("DFO-" + UID());
@@ -106,9 +157,11 @@ DFOApplication::generate_modules(conffwk::Configuration* confdb,
 
   // Process special Network rules!
   // Looking for DataRequest rules from ReadoutAppplications in current Session
-  auto sessionApps = session->get_enabled_applications();
+  auto sessionApps = enabled_applications(session);
   std::vector<conffwk::ConfigObject> tdOutObjs;
+  std::vector<const DFApplication*> tdOutApps;
   for (auto app : sessionApps) {
+    GenerationDependencies::note_read(app);
     auto dfapp = app->cast<appmodel::DFApplication>();
     if (dfapp == nullptr)
       continue;
@@ -127,6 +180,7 @@ DFOApplication::generate_modules(conffwk::Configuration* confdb,
 
         auto serviceObj = descriptor->get_associated_service()->config_object();
         tdOutObjs.back().set_obj("associated_service", &serviceObj);
+        tdOutApps.push_back(dfapp);
       } // If network rule has TriggerDecision type of data
     }   // Loop over Apps network rules
   }     // loop over Session specific Apps
@@ -135,6 +189,36 @@ DFOApplication::generate_modules(conffwk::Configuration* confdb,
     output_conns.push_back(&tdOut);
   }
 
+  // TriggerDecisions held back for batching must not outlive the TriggerRecord they start
+  if (dfoConf->get_td_max_batch_size() == 0) {
+    throw(BadConf(ERS_HERE, "DFOConf " + dfoConf->UID() + ": td_max_batch_size must be at least 1"));
+  }
+  if (dfoConf->get_td_batch_window_us() != 0) {
+    for (auto dfapp : tdOutApps) {
+      uint64_t tr_timeout_us = static_cast<uint64_t>(dfapp->get_trb()->get_trigger_record_timeout_ms()) * 1000;
+      if (tr_timeout_us != 0 && dfoConf->get_td_batch_window_us() >= tr_timeout_us) {
+        throw(BadConf(ERS_HERE,
+                      "DFOConf " + dfoConf->UID() + ": td_batch_window_us is not shorter than the TriggerRecord timeout of " +
+                        dfapp->UID()));
+      }
+    }
+  }
+
+  if (dfoConf->get_auto_tune_thresholds()) {
+    std::vector<conffwk::ConfigObject> targetObjs(tdOutObjs.size());
+    std::vector<const conffwk::ConfigObject*> targets;
+    for (size_t i = 0; i < tdOutObjs.size(); ++i) {
+      auto params = tune_dispatch_params(dfoConf, tdOutApps[i]);
+      confdb->create(dbfile, "DFOTarget", "dfo-target-" + tdOutObjs[i].UID(), targetObjs[i]);
+      targetObjs[i].set_by_val<int32_t>("busy_threshold", params.busy);
+      targetObjs[i].set_by_val<int32_t>("free_threshold", params.free);
+      targetObjs[i].set_by_val<uint32_t>("weight", params.weight);
+      targetObjs[i].set_obj("decision_connection", &tdOutObjs[i]);
+      targets.push_back(&targetObjs[i]);
+    }
+    dfoObj.set_objs("targets", targets);
+  }
+
   dfoObj.set_objs("inputs", input_conns);
   dfoObj.set_objs("outputs", output_conns);
 
@@ -8,7 +8,10 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
+#include "Colocation.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
 
 #include "conffwk/Configuration.hpp"
 #include "oks/kernel.hpp"
@@ -33,6 +36,7 @@
 
 #include "logging/Logging.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -48,47 +52,43 @@ static ModuleFactory::Registrator __reg__("FakeDataApplication",
                                             return app->generate_modules(confdb, dbfile, session);
                                           });
 
+std::vector<uint32_t>
+FakeDataProdConf::source_ids() const
+{
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < get_number_of_sources(); ++i) {
+    ids.push_back(get_source_id() + i);
+  }
+  return ids;
+}
+
 std::vector<const confmodel::DaqModule*>
 FakeDataApplication::generate_modules(conffwk::Configuration* confdb,
                                       const std::string& dbfile,
                                       const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   // oks::OksFile::set_nolock_mode(true);
 
   std::vector<const confmodel::DaqModule*> modules;
 
-  // Process the queue rules looking for inputs to our DL/TP handler modules
-  const QueueDescriptor* dlhReqInputQDesc = nullptr;
-  const QueueDescriptor* faOutputQDesc = nullptr;
+  RuleIndex rules(this);
 
-  for (auto rule : get_queue_rules()) {
-    auto destination_class = rule->get_destination_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-    if (destination_class == "FakeDataProdModule") {
-      if (data_type == "DataRequest") {
-        dlhReqInputQDesc = rule->get_descriptor();
-      }
-    } else if (destination_class == "FragmentAggregatorModule") {
-      faOutputQDesc = rule->get_descriptor();
-    }
-  }
+  // Inputs to our DL/TP handler modules
+  const QueueDescriptor* dlhReqInputQDesc = rules.queue("DataRequest", "FakeDataProdModule");
+  const QueueDescriptor* faOutputQDesc = rules.queue_to("FragmentAggregatorModule");
   if (faOutputQDesc == nullptr) {
     throw(BadConf(ERS_HERE, "No fragment output queue descriptor given"));
   }
   if (dlhReqInputQDesc == nullptr) {
     throw(BadConf(ERS_HERE, "No DLH request input queue descriptor given"));
   }
-  // Process the network rules looking for the Fragment Aggregator and TP handler data reuest inputs
-  const NetworkConnectionDescriptor* faNetDesc = nullptr;
-  const NetworkConnectionDescriptor* tsNetDesc = nullptr;
-  for (auto rule : get_network_rules()) {
-    auto endpoint_class = rule->get_endpoint_class();
-    if (endpoint_class == "FragmentAggregatorModule") {
-      faNetDesc = rule->get_descriptor();
-    } else if (endpoint_class == "FakeDataProdModule") {
-      tsNetDesc = rule->get_descriptor();
-    }
-  }
+  // The Fragment Aggregator data request input and the TimeSync output
+  const NetworkConnectionDescriptor* faNetDesc = rules.network_to("FragmentAggregatorModule");
+  const NetworkConnectionDescriptor* tsNetDesc = rules.network_to("FakeDataProdModule");
   if (faNetDesc == nullptr) {
     throw(BadConf(ERS_HERE, "No Fragment output network descriptor given"));
   }
@@ -110,7 +110,7 @@ FakeDataApplication::generate_modules(conffwk::Configuration* confdb,
 
 
   // Create a FakeDataProdModule for each stream of this Readout Group
-  for (auto fdpConf : get_contains()) {
+  for (auto fdpConf : sorted_by_uid(get_contains())) {
     if (fdpConf->disabled(*session)) {
       TLOG_DEBUG(7) << "Ignoring disabled FakeDataProdConf " << fdpConf->UID();
       continue;
@@ -121,37 +121,54 @@ FakeDataApplication::generate_modules(conffwk::Configuration* confdb,
       throw(BadConf(ERS_HERE, "ReadoutGroup contains something other than FakeDataProdConf"));
     }
 
-    auto id = stream->get_source_id();
-    std::string uid("FakeDataProdModule-" + std::to_string(id));
-    conffwk::ConfigObject dlhObj;
-    TLOG_DEBUG(7) << "creating OKS configuration object for FakeDataProdModule";
-    confdb->create(dbfile, "FakeDataProdModule", uid, dlhObj);
-    dlhObj.set_obj("configuration", &stream->config_object());
-
-    // Time Sync network connection
-    std::string tsStreamUid = tsNetDesc->get_uid_base() + std::to_string(id);
-    auto tsServiceObj = tsNetDesc->get_associated_service()->config_object();
-    conffwk::ConfigObject tsNetObj;
-    confdb->create(dbfile, "NetworkConnection", tsStreamUid, tsNetObj);
-    tsNetObj.set_by_val<std::string>("connection_type", tsNetDesc->get_connection_type());
-    tsNetObj.set_by_val<std::string>("data_type", tsNetDesc->get_data_type());
-    tsNetObj.set_obj("associated_service", &tsServiceObj);
-
-    dlhObj.set_objs("outputs", { &faQueueObj, &tsNetObj });
-
-    std::string reqQueueUid(dlhReqInputQDesc->get_uid_base() + std::to_string(id));
-    conffwk::ConfigObject reqQueueObj;
-    confdb->create(dbfile, "QueueWithSourceId", reqQueueUid, reqQueueObj);
-    reqQueueObj.set_by_val<std::string>("data_type", dlhReqInputQDesc->get_data_type());
-    reqQueueObj.set_by_val<std::string>("queue_type", dlhReqInputQDesc->get_queue_type());
-    reqQueueObj.set_by_val<uint32_t>("capacity", dlhReqInputQDesc->get_capacity());
-    reqQueueObj.set_by_val<uint32_t>("source_id", stream->get_source_id());
-    // Add the requessts queue dal pointer to the outputs of the FragmentAggregatorModule
-    faOutputQueues.push_back(confdb->get<confmodel::Connection>(reqQueueUid));
-
-    dlhObj.set_objs("inputs", { &reqQueueObj });
-
-    modules.push_back(confdb->get<FakeDataProdModule>(uid));
+    if (stream->get_sources_per_producer() == 0) {
+      throw(BadConf(ERS_HERE, "sources_per_producer of " + stream->UID() + " must be at least 1"));
+    }
+
+    // Split the source range among producers, each with one TimeSync publisher
+    auto source_ids = stream->source_ids();
+    for (size_t first = 0; first < source_ids.size(); first += stream->get_sources_per_producer()) {
+      std::vector<uint32_t> producer_ids(source_ids.begin() + first,
+                                         source_ids.begin() +
+                                           std::min<size_t>(first + stream->get_sources_per_producer(), source_ids.size()));
+      auto id = producer_ids.front();
+      std::string uid("FakeDataProdModule-" + std::to_string(id));
+      conffwk::ConfigObject dlhObj;
+      TLOG_DEBUG(7) << "creating OKS configuration object for FakeDataProdModule";
+      confdb->create(dbfile, "FakeDataProdModule", uid, dlhObj);
+      dlhObj.set_obj("configuration", &stream->config_object());
+      dlhObj.set_by_val<std::vector<uint32_t>>("source_ids", producer_ids);
+
+      // Time Sync network connection
+      std::string tsStreamUid = tsNetDesc->get_uid_base() + std::to_string(id);
+      auto tsServiceObj = tsNetDesc->get_associated_service()->config_object();
+      conffwk::ConfigObject tsNetObj;
+      confdb->create(dbfile, "NetworkConnection", tsStreamUid, tsNetObj);
+      tsNetObj.set_by_val<std::string>("connection_type", tsNetDesc->get_connection_type());
+      tsNetObj.set_by_val<std::string>("data_type", tsNetDesc->get_data_type());
+      tsNetObj.set_obj("associated_service", &tsServiceObj);
+
+      dlhObj.set_objs("outputs", { &faQueueObj, &tsNetObj });
+
+      // One request queue per source, so that the FragmentAggregatorModule can route by SourceID
+      std::vector<conffwk::ConfigObject> reqQueueObjs(producer_ids.size());
+      std::vector<const conffwk::ConfigObject*> reqQueuePtrs;
+      for (size_t i = 0; i < producer_ids.size(); ++i) {
+        std::string reqQueueUid(dlhReqInputQDesc->get_uid_base() + std::to_string(producer_ids[i]));
+        confdb->create(dbfile, "QueueWithSourceId", reqQueueUid, reqQueueObjs[i]);
+        reqQueueObjs[i].set_by_val<std::string>("data_type", dlhReqInputQDesc->get_data_type());
+        reqQueueObjs[i].set_by_val<std::string>("queue_type", dlhReqInputQDesc->get_queue_type());
+        reqQueueObjs[i].set_by_val<uint32_t>("capacity", dlhReqInputQDesc->get_capacity());
+        reqQueueObjs[i].set_by_val<uint32_t>("source_id", producer_ids[i]);
+        // Add the requessts queue dal pointer to the outputs of the FragmentAggregatorModule
+        faOutputQueues.push_back(confdb->get<confmodel::Connection>(reqQueueUid));
+        reqQueuePtrs.push_back(&reqQueueObjs[i]);
+      }
+
+      dlhObj.set_objs("inputs", reqQueuePtrs);
+
+      modules.push_back(confdb->get<FakeDataProdModule>(uid));
+    }
   }
 
   // Finally create Fragment Aggregator
@@ -164,7 +181,7 @@ FakeDataApplication::generate_modules(conffwk::Configuration* confdb,
   auto faServiceObj = faNetDesc->get_associated_service()->config_object();
   std::string faNetUid = faNetDesc->get_uid_base() + UID();
   conffwk::ConfigObject faNetObj;
-  confdb->create(dbfile, "NetworkConnection", faNetUid, faNetObj);
+  confdb->create(dbfile, data_request_connection_class(faNetDesc, this, session), faNetUid, faNetObj);
   faNetObj.set_by_val<std::string>("connection_type", faNetDesc->get_connection_type());
   faNetObj.set_by_val<std::string>("data_type", faNetDesc->get_data_type());
   faNetObj.set_obj("associated_service", &faServiceObj);
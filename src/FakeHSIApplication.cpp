@@ -8,7 +8,10 @@
  * received with this code.
  */
 
+#include "Colocation.hpp"
+#include "HSI2TCTranslator.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
 
 #include "appmodel/FakeHSIApplication.hpp"
 #include "appmodel/FakeHSIEventGeneratorModule.hpp"
@@ -47,43 +50,22 @@ static ModuleFactory::Registrator __reg__("FakeHSIApplication",
 std::vector<const confmodel::DaqModule*>
 FakeHSIApplication::generate_modules(conffwk::Configuration* confdb,
                                      const std::string& dbfile,
-                                     const confmodel::Session* /*session*/) const
+                                     const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   auto dlhConf = get_link_handler();
   auto dlhClass = dlhConf->get_template_for();
 
-  const QueueDescriptor* dlhInputQDesc = nullptr;
-
-  for (auto rule : get_queue_rules()) {
-    auto destination_class = rule->get_destination_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-    if (destination_class == "DataHandlerModule" || destination_class == dlhClass) {
-      dlhInputQDesc = rule->get_descriptor();
-    }
-  }
-
-  const NetworkConnectionDescriptor* dlhReqInputNetDesc = nullptr;
-  const NetworkConnectionDescriptor* tsNetDesc = nullptr;
-  const NetworkConnectionDescriptor* hsiNetDesc = nullptr;
-
-  for (auto rule : get_network_rules()) {
-    auto endpoint_class = rule->get_endpoint_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-
-    if (endpoint_class == "DataHandlerModule" || endpoint_class == dlhClass) {
-      if (data_type == "TimeSync") {
-        tsNetDesc = rule->get_descriptor();
-      }
-      if (data_type == "DataRequest") {
-        dlhReqInputNetDesc = rule->get_descriptor();
-      }
-    }
-    if (data_type == "HSIEvent") {
-      hsiNetDesc = rule->get_descriptor();
-    }
-  }
+  RuleIndex rules(this);
+  const QueueDescriptor* dlhInputQDesc = rules.queue("", { dlhClass, "DataHandlerModule" });
+  const NetworkConnectionDescriptor* dlhReqInputNetDesc = rules.network("DataRequest", { dlhClass, "DataHandlerModule" });
+  const NetworkConnectionDescriptor* tsNetDesc = rules.network("TimeSync", { dlhClass, "DataHandlerModule" });
+  const NetworkConnectionDescriptor* hsiNetDesc = rules.network("HSIEvent");
 
   auto rdrConf = get_generator();
   if (rdrConf == 0) {
@@ -95,7 +77,8 @@ FakeHSIApplication::generate_modules(conffwk::Configuration* confdb,
   if (dlhReqInputNetDesc == nullptr) {
     throw(BadConf(ERS_HERE, "No DLH request input network descriptor given"));
   }
-  if (hsiNetDesc == nullptr) {
+  auto hstcConf = get_hsevent_to_tc_conf();
+  if (hsiNetDesc == nullptr && hstcConf == nullptr) {
     throw(BadConf(ERS_HERE, "No HSIEvent output network descriptor given"));
   }
 
@@ -140,7 +123,7 @@ FakeHSIApplication::generate_modules(conffwk::Configuration* confdb,
   auto faServiceObj = dlhReqInputNetDesc->get_associated_service()->config_object();
   std::string faNetUid = dlhReqInputNetDesc->get_uid_base() + UID();
   conffwk::ConfigObject faNetObj;
-  confdb->create(dbfile, "NetworkConnection", faNetUid, faNetObj);
+  confdb->create(dbfile, data_request_connection_class(dlhReqInputNetDesc, this, session), faNetUid, faNetObj);
   faNetObj.set_by_val<std::string>("connection_type", dlhReqInputNetDesc->get_connection_type());
   faNetObj.set_by_val<std::string>("data_type", dlhReqInputNetDesc->get_data_type());
   faNetObj.set_obj("associated_service", &faServiceObj);
@@ -149,19 +132,24 @@ FakeHSIApplication::generate_modules(conffwk::Configuration* confdb,
 
   modules.push_back(confdb->get<DataHandlerModule>(uid));
 
-  auto hsiServiceObj = hsiNetDesc->get_associated_service()->config_object();
-  std::string hsiNetUid = hsiNetDesc->get_uid_base();
-  conffwk::ConfigObject hsiNetObj;
-  confdb->create(dbfile, "NetworkConnection", hsiNetUid, hsiNetObj);
-  hsiNetObj.set_by_val<std::string>("connection_type", hsiNetDesc->get_connection_type());
-  hsiNetObj.set_by_val<std::string>("data_type", hsiNetDesc->get_data_type());
-  hsiNetObj.set_obj("associated_service", &hsiServiceObj);
-  
+  // HSIEvents go either to the co-located translator or over the network
+  conffwk::ConfigObject hsiOutObj;
+  if (hstcConf != nullptr) {
+    modules.push_back(create_colocated_hsi2tc(this, hstcConf, confdb, dbfile, hsiOutObj));
+  } else {
+    auto hsiServiceObj = hsiNetDesc->get_associated_service()->config_object();
+    std::string hsiNetUid = hsiNetDesc->get_uid_base();
+    confdb->create(dbfile, "NetworkConnection", hsiNetUid, hsiOutObj);
+    hsiOutObj.set_by_val<std::string>("connection_type", hsiNetDesc->get_connection_type());
+    hsiOutObj.set_by_val<std::string>("data_type", hsiNetDesc->get_data_type());
+    hsiOutObj.set_obj("associated_service", &hsiServiceObj);
+  }
+
   std::string genuid("FakeHSI-" + std::to_string(id));
   conffwk::ConfigObject fakehsiObj;
   confdb->create(dbfile, "FakeHSIEventGeneratorModule", genuid, fakehsiObj);
   fakehsiObj.set_obj("configuration", &rdrConf->config_object());
-  fakehsiObj.set_objs("outputs", { &queueObj, &hsiNetObj });
+  fakehsiObj.set_objs("outputs", { &queueObj, &hsiOutObj });
 
   modules.push_back(confdb->get<FakeHSIEventGeneratorModule>(genuid));
 
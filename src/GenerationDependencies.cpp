@@ -0,0 +1,136 @@
+/**
+ * @file GenerationDependencies.cpp
+ *
+ * Recording of the dependencies of generated objects
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "appmodel/GenerationDependencies.hpp"
+#include "appmodel/ConfigSlice.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <filesystem>
+
+namespace dunedaq::appmodel {
+
+namespace {
+
+// Objects read by the generator running on this thread, if recording
+thread_local std::vector<conffwk::ConfigObject>* t_reads = nullptr;
+
+// The segment tree leads to every application of the session: reads of
+// other applications are recorded explicitly instead
+const std::set<std::string> c_stop = { "Segment.segments", "Segment.applications", "Session.segment" };
+
+std::string
+normalized_path(const std::string& file)
+{
+  return std::filesystem::weakly_canonical(std::filesystem::absolute(file)).string();
+}
+
+bool
+contained_in(const conffwk::ConfigObject& obj, const std::string& file)
+{
+  return !obj.contained_in().empty() && normalized_path(obj.contained_in()) == file;
+}
+
+} // namespace
+
+void
+GenerationDependencies::note_read(const conffwk::DalObject* obj)
+{
+  if (t_reads != nullptr && obj != nullptr) {
+    t_reads->push_back(obj->config_object());
+  }
+}
+
+std::vector<const confmodel::DaqModule*>
+GenerationDependencies::generate(conffwk::Configuration* confdb,
+                                 const std::string& dbfile,
+                                 const confmodel::Session* session,
+                                 const SmartDaqApplication* app)
+{
+  std::vector<conffwk::ConfigObject> reads;
+  struct Recording
+  {
+    explicit Recording(std::vector<conffwk::ConfigObject>* reads) { t_reads = reads; }
+    ~Recording() { t_reads = nullptr; }
+  };
+
+  std::vector<const confmodel::DaqModule*> modules;
+  {
+    Recording recording(&reads);
+    modules = app->generate_modules(confdb, dbfile, session);
+  }
+
+  // Dependencies shared by all the generated objects of the application
+  std::vector<conffwk::ConfigObject> app_roots{ app->config_object() };
+  app_roots.insert(app_roots.end(), reads.begin(), reads.end());
+  std::set<std::string> app_sources;
+  for (auto& obj : reference_closure(*confdb, app_roots, c_stop)) {
+    app_sources.insert(obj.full_name());
+  }
+
+  // The generated objects are those reached from the modules within dbfile
+  auto gen_file = normalized_path(dbfile);
+  std::vector<conffwk::ConfigObject> module_objs;
+  for (auto module : modules) {
+    module_objs.push_back(module->config_object());
+  }
+  std::vector<conffwk::ConfigObject> generated;
+  for (auto& obj : reference_closure(*confdb, module_objs, c_stop)) {
+    if (contained_in(obj, gen_file)) {
+      generated.push_back(obj);
+    }
+  }
+
+  for (auto& obj : generated) {
+    auto& deps = m_dependencies[obj.full_name()];
+    deps = app_sources;
+    for (auto& related : reference_closure(*confdb, { obj }, c_stop)) {
+      if (!contained_in(related, gen_file)) {
+        deps.insert(related.full_name());
+      }
+    }
+    m_application_of[obj.full_name()] = app->UID();
+  }
+
+  TLOG_DEBUG(6) << "Recorded dependencies of " << generated.size() << " objects generated for " << app->UID()
+                << ", " << reads.size() << " objects of other applications read";
+  return modules;
+}
+
+std::set<std::string>
+GenerationDependencies::sources_of(const std::string& generated) const
+{
+  auto it = m_dependencies.find(generated);
+  return it != m_dependencies.end() ? it->second : std::set<std::string>{};
+}
+
+std::set<std::string>
+GenerationDependencies::affected_by(const std::string& object) const
+{
+  std::set<std::string> affected;
+  for (auto& [generated, deps] : m_dependencies) {
+    if (deps.count(object)) {
+      affected.insert(generated);
+    }
+  }
+  return affected;
+}
+
+std::set<std::string>
+GenerationDependencies::applications_affected_by(const std::string& object) const
+{
+  std::set<std::string> apps;
+  for (auto& generated : affected_by(object)) {
+    apps.insert(m_application_of.at(generated));
+  }
+  return apps;
+}
+
+} // namespace dunedaq::appmodel
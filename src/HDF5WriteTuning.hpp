@@ -0,0 +1,93 @@
+#ifndef HDF5WRITETUNING_HPP
+#define HDF5WRITETUNING_HPP
+
+#include "appmodel/DataStoreConf.hpp"
+#include "appmodel/HDF5FileLayoutParams.hpp"
+#include "appmodel/HDF5PathParams.hpp"
+#include "appmodel/HDF5WriteParams.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include "conffwk/Configuration.hpp"
+#include "logging/Logging.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <string>
+
+namespace dunedaq::appmodel {
+
+/**
+ * Resolve the write_params profile of a DataStoreConf for one writer module.
+ * Returns false if the DataStoreConf has no profile, otherwise creates
+ * write_obj with uid "hdf5write-<writer_uid>":
+ *  - io_mode kAuto becomes kDirect if direct_io_supported, else kBuffered;
+ *    kDirect on storage without O_DIRECT support is an error
+ *  - alignment 0 becomes io_block_size
+ *  - chunk_size 0 becomes the largest expected_fragment_size of the
+ *    path_params_list rounded up to the alignment, or stays 0 (library
+ *    default) if no size is known
+ * With kDirect the chunk size must be a multiple of the alignment.
+ */
+inline bool
+create_hdf5_write_params(conffwk::Configuration* confdb,
+                         const std::string& dbfile,
+                         const std::string& writer_uid,
+                         const DataStoreConf* store,
+                         bool direct_io_supported,
+                         uint32_t io_block_size,
+                         conffwk::ConfigObject& write_obj)
+{
+  auto profile = store->get_write_params();
+  if (profile == nullptr) {
+    return false;
+  }
+
+  std::string io_mode = profile->get_io_mode();
+  if (io_mode == "kAuto") {
+    io_mode = direct_io_supported ? "kDirect" : "kBuffered";
+  }
+  else if (io_mode == "kDirect" && !direct_io_supported) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("HDF5WriteParams {} requests direct I/O but the storage of {} does not support it",
+                              profile->UID(),
+                              writer_uid)));
+  }
+
+  uint32_t alignment = profile->get_alignment() != 0 ? profile->get_alignment() : io_block_size;
+
+  uint64_t chunk_size = profile->get_chunk_size();
+  if (chunk_size == 0) {
+    uint64_t fragment_size = 0;
+    for (auto path : store->get_file_layout_params()->get_path_params_list()) {
+      fragment_size = std::max(fragment_size, path->get_expected_fragment_size());
+    }
+    if (fragment_size != 0 && alignment != 0) {
+      chunk_size = (fragment_size + alignment - 1) / alignment * alignment;
+    }
+    else {
+      chunk_size = fragment_size;
+    }
+  }
+  if (io_mode == "kDirect" && (alignment == 0 || chunk_size % alignment != 0)) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("Chunk size {} of {} is not a multiple of the alignment {} required by direct I/O",
+                              chunk_size,
+                              writer_uid,
+                              alignment)));
+  }
+
+  TLOG_DEBUG(7) << "HDF5 write parameters of " << writer_uid << ": " << io_mode << ", chunk " << chunk_size
+                << ", alignment " << alignment;
+
+  confdb->create(dbfile, "HDF5WriteParams", "hdf5write-" + writer_uid, write_obj);
+  write_obj.set_enum("io_mode", io_mode);
+  write_obj.set_by_val<uint64_t>("chunk_size", chunk_size);
+  write_obj.set_by_val<uint32_t>("alignment", alignment);
+  write_obj.set_enum("compression", profile->get_compression());
+  write_obj.set_by_val<uint16_t>("compression_level", profile->get_compression_level());
+  return true;
+}
+
+} // namespace dunedaq::appmodel
+#endif // HDF5WRITETUNING_HPP
@@ -0,0 +1,75 @@
+#ifndef HSI2TCTRANSLATOR_HPP
+#define HSI2TCTRANSLATOR_HPP
+
+#include "RuleIndex.hpp"
+
+#include "appmodel/DataReaderConf.hpp"
+#include "appmodel/DataSubscriberModule.hpp"
+#include "appmodel/HSI2TCTranslatorConf.hpp"
+#include "appmodel/NetworkConnectionDescriptor.hpp"
+#include "appmodel/NetworkConnectionRule.hpp"
+#include "appmodel/QueueConnectionRule.hpp"
+#include "appmodel/QueueDescriptor.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+#include "conffwk/Configuration.hpp"
+#include "confmodel/Service.hpp"
+#include "logging/Logging.hpp"
+
+#include <string>
+
+namespace dunedaq::appmodel {
+
+/**
+ * Create the HSIEvent to TriggerCandidate translator inside an HSI
+ * application. The translator reads HSIEvents from hsi_queue_obj, which is
+ * created here from the queue rule of the application with destination
+ * DataSubscriberModule, and publishes TriggerCandidates on the connection
+ * given by its TriggerCandidate network rule.
+ */
+inline const confmodel::DaqModule*
+create_colocated_hsi2tc(const SmartDaqApplication* app,
+                        const DataReaderConf* conf,
+                        conffwk::Configuration* confdb,
+                        const std::string& dbfile,
+                        conffwk::ConfigObject& hsi_queue_obj)
+{
+  if (conf->cast<HSI2TCTranslatorConf>() == nullptr) {
+    throw(BadConf(ERS_HERE, "hsevent_to_tc_conf of " + app->UID() + " is not a HSI2TCTranslatorConf"));
+  }
+
+  RuleIndex rules(app);
+  const QueueDescriptor* hsiQDesc = rules.queue_to("DataSubscriberModule");
+  const NetworkConnectionDescriptor* tcNetDesc = rules.network("TriggerCandidate");
+  if (hsiQDesc == nullptr) {
+    throw(BadConf(ERS_HERE, "No HSIEvent queue descriptor to the DataSubscriberModule given"));
+  }
+  if (tcNetDesc == nullptr) {
+    throw(BadConf(ERS_HERE, "No TriggerCandidate output network descriptor given"));
+  }
+
+  confdb->create(dbfile, "Queue", hsiQDesc->get_uid_base() + app->UID(), hsi_queue_obj);
+  hsi_queue_obj.set_by_val<std::string>("data_type", hsiQDesc->get_data_type());
+  hsi_queue_obj.set_by_val<std::string>("queue_type", hsiQDesc->get_queue_type());
+  hsi_queue_obj.set_by_val<uint32_t>("capacity", hsiQDesc->get_capacity());
+
+  auto tcServiceObj = tcNetDesc->get_associated_service()->config_object();
+  conffwk::ConfigObject tcNetObj;
+  confdb->create(dbfile, "NetworkConnection", tcNetDesc->get_uid_base() + app->UID(), tcNetObj);
+  tcNetObj.set_by_val<std::string>("data_type", tcNetDesc->get_data_type());
+  tcNetObj.set_by_val<std::string>("connection_type", tcNetDesc->get_connection_type());
+  tcNetObj.set_obj("associated_service", &tcServiceObj);
+
+  std::string hstcUid("hsi2tc-" + app->UID());
+  conffwk::ConfigObject hstcObj;
+  TLOG_DEBUG(7) << "creating OKS configuration object for the co-located DataSubscriberModule of " << app->UID();
+  confdb->create(dbfile, "DataSubscriberModule", hstcUid, hstcObj);
+  hstcObj.set_obj("configuration", &conf->config_object());
+  hstcObj.set_objs("inputs", { &hsi_queue_obj });
+  hstcObj.set_objs("outputs", { &tcNetObj });
+
+  return confdb->get<DataSubscriberModule>(hstcUid);
+}
+
+} // namespace dunedaq::appmodel
+#endif // HSI2TCTRANSLATOR_HPP
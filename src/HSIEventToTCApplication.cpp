@@ -45,8 +45,12 @@ __reg__("HSIEventToTCApplication", [] (const SmartDaqApplication* smartApp,
 std::vector<const confmodel::DaqModule*> 
 HSIEventToTCApplication::generate_modules(conffwk::Configuration* confdb,
                                      const std::string& dbfile,
-                                     const confmodel::Session* /*session*/) const
+                                     const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
 
@@ -0,0 +1,349 @@
+/**
+ * @file LaunchPlan.cpp
+ *
+ * Building, writing and reading of session launch plans
+ *
+ * This is part of the DUNE DAQ Software Suite, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "appmodel/LaunchPlan.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include "confmodel/Application.hpp"
+#include "confmodel/Component.hpp"
+#include "confmodel/DaqApplication.hpp"
+#include "confmodel/PhysicalHost.hpp"
+#include "confmodel/RCApplication.hpp"
+#include "confmodel/Segment.hpp"
+#include "confmodel/Variable.hpp"
+#include "confmodel/VariableSet.hpp"
+#include "confmodel/VirtualHost.hpp"
+#include "logging/Logging.hpp"
+
+#include <fmt/core.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <set>
+#include <sstream>
+#include <utility>
+
+namespace dunedaq::appmodel {
+
+namespace {
+
+const std::string c_plan_magic = "appmodel-launch-plan-1";
+
+void
+collect_variables(const std::vector<const confmodel::VariableBase*>& variables,
+                  std::map<std::string, std::string>& env)
+{
+  for (auto item : variables) {
+    if (auto set = item->cast<confmodel::VariableSet>()) {
+      collect_variables(set->get_contains(), env);
+    }
+    else if (auto var = item->cast<confmodel::Variable>()) {
+      env[var->get_name()] = var->get_value();
+    }
+  }
+}
+
+bool
+component_disabled(const conffwk::DalObject* obj, const confmodel::Session* session)
+{
+  auto component = obj->cast<confmodel::Component>();
+  return component != nullptr && component->disabled(*session);
+}
+
+// Enabled applications in the order of app_environment_cli
+void
+collect_applications(const confmodel::Segment* segment,
+                     const confmodel::Session* session,
+                     std::vector<const confmodel::Application*>& apps)
+{
+  for (auto seg : segment->get_segments()) {
+    if (component_disabled(seg, session)) {
+      TLOG_DEBUG(5) << "Ignoring disabled segment " << seg->UID();
+      continue;
+    }
+    collect_applications(seg, session, apps);
+  }
+  apps.push_back(segment->get_controller());
+  for (auto app : segment->get_applications()) {
+    if (!component_disabled(app, session)) {
+      apps.push_back(app);
+    }
+  }
+}
+
+AppLaunchEntry
+evaluate_application(conffwk::Configuration* confdb,
+                     const confmodel::Session* session,
+                     const confmodel::Application* app,
+                     const std::map<std::string, std::string>& session_env)
+{
+  AppLaunchEntry entry;
+  entry.uid = app->UID();
+  entry.application_name = app->get_application_name();
+  if (app->get_runs_on() != nullptr && app->get_runs_on()->get_runs_on() != nullptr) {
+    entry.host = app->get_runs_on()->get_runs_on()->UID();
+  }
+
+  entry.environment = session_env;
+  collect_variables(app->get_application_environment(), entry.environment);
+
+  if (auto rcapp = app->cast<confmodel::RCApplication>()) {
+    entry.commandline = rcapp->construct_commandline_parameters(*confdb, session);
+  }
+  else if (auto sdapp = app->cast<SmartDaqApplication>()) {
+    entry.commandline = sdapp->construct_commandline_parameters(*confdb, session);
+  }
+  else if (auto dapp = app->cast<confmodel::DaqApplication>()) {
+    entry.commandline = dapp->construct_commandline_parameters(*confdb, session);
+  }
+  else {
+    entry.commandline = app->get_commandline_parameters();
+  }
+  return entry;
+}
+
+// Strings are written as <size>:<bytes> so that any content survives
+void
+write_string(std::ostream& out, const std::string& str)
+{
+  out << str.size() << ':' << str;
+}
+
+// Sizes are checked against max_size, the size of the whole plan, so that a
+// corrupt plan is rejected rather than allocating an arbitrary amount
+bool
+read_string(std::istream& in, std::string& str, size_t max_size)
+{
+  size_t size = 0;
+  char sep = 0;
+  if (!(in >> size) || !in.get(sep) || sep != ':' || size > max_size) {
+    return false;
+  }
+  str.resize(size);
+  return static_cast<bool>(in.read(str.data(), size));
+}
+
+// Counts of strings: each string takes at least two bytes
+bool
+read_size(std::istream& in, size_t& size, size_t max_size)
+{
+  std::string str;
+  if (!read_string(in, str, max_size)) {
+    return false;
+  }
+  try {
+    size = std::stoul(str);
+  } catch (const std::exception&) {
+    return false;
+  }
+  return size <= max_size / 2;
+}
+
+// An included file as OKS finds it: absolute, next to the including file or
+// in one of the DUNEDAQ_DB_PATH directories
+std::string
+resolve_include(const std::string& include, const std::filesystem::path& including_dir)
+{
+  std::filesystem::path path(include);
+  if (path.is_absolute()) {
+    return std::filesystem::exists(path) ? path.string() : "";
+  }
+  if (std::filesystem::exists(including_dir / path)) {
+    return (including_dir / path).string();
+  }
+  if (auto db_path = std::getenv("DUNEDAQ_DB_PATH")) {
+    std::istringstream dirs(db_path);
+    std::string dir;
+    while (std::getline(dirs, dir, ':')) {
+      if (!dir.empty() && std::filesystem::exists(std::filesystem::path(dir) / path)) {
+        return (std::filesystem::path(dir) / path).string();
+      }
+    }
+  }
+  return "";
+}
+
+} // namespace
+
+std::vector<std::string>
+database_files(const conffwk::Configuration& confdb, const std::string& dbfile)
+{
+  std::vector<std::string> files{ dbfile };
+  // Includes are reported as written in the including file
+  std::set<std::string> seen{ dbfile };
+  std::list<std::pair<std::string, std::string>> pending{ { dbfile, dbfile } };
+  while (!pending.empty()) {
+    auto [name, path] = pending.front();
+    pending.pop_front();
+    std::list<std::string> includes;
+    confdb.get_includes(name, includes);
+    for (auto& include : includes) {
+      if (!seen.insert(include).second) {
+        continue;
+      }
+      auto include_path = resolve_include(include, std::filesystem::path(path).parent_path());
+      if (include_path.empty()) {
+        TLOG_DEBUG(5) << "Included file " << include << " not found, not hashed";
+        continue;
+      }
+      files.push_back(include_path);
+      pending.push_back({ include, include_path });
+    }
+  }
+  return files;
+}
+
+std::string
+database_hash(const std::vector<std::string>& files, const std::string& session_name)
+{
+  // 64 bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  auto add = [&hash](const std::string& data) {
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 0x100000001b3ULL;
+    }
+  };
+
+  add(session_name);
+  for (auto& file : files) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      throw(BadConf(ERS_HERE, "Cannot read database file " + file));
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    add(file);
+    add(contents.str());
+  }
+  return fmt::format("{:016x}", hash);
+}
+
+LaunchPlan
+build_launch_plan(conffwk::Configuration* confdb,
+                  const confmodel::Session* session,
+                  const std::string& database_hash)
+{
+  LaunchPlan plan;
+  plan.session = session->UID();
+  plan.database_hash = database_hash;
+  plan.rte_script = session->get_rte_script();
+
+  std::map<std::string, std::string> session_env;
+  collect_variables(session->get_environment(), session_env);
+
+  std::vector<const confmodel::Application*> apps;
+  collect_applications(session->get_segment(), session, apps);
+  plan.apps.resize(apps.size());
+
+  // conffwk does not support concurrent access to one Configuration
+  for (size_t i = 0; i < apps.size(); ++i) {
+    plan.apps[i] = evaluate_application(confdb, session, apps[i], session_env);
+  }
+
+  TLOG_DEBUG(5) << "Launch plan of " << plan.session << " has " << plan.apps.size() << " applications";
+  return plan;
+}
+
+void
+write_launch_plan(const LaunchPlan& plan, const std::string& path)
+{
+  std::ostringstream out;
+  write_string(out, c_plan_magic);
+  write_string(out, plan.database_hash);
+  write_string(out, plan.session);
+  write_string(out, plan.rte_script);
+  write_string(out, std::to_string(plan.apps.size()));
+  for (auto& app : plan.apps) {
+    write_string(out, app.uid);
+    write_string(out, app.host);
+    write_string(out, app.application_name);
+    write_string(out, std::to_string(app.environment.size()));
+    for (auto& [name, value] : app.environment) {
+      write_string(out, name);
+      write_string(out, value);
+    }
+    write_string(out, std::to_string(app.commandline.size()));
+    for (auto& arg : app.commandline) {
+      write_string(out, arg);
+    }
+  }
+
+  // Write to a temporary file and rename so readers never see a partial plan
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file << out.str();
+    if (!file) {
+      throw(BadConf(ERS_HERE, "Cannot write launch plan " + tmp_path));
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    throw(BadConf(ERS_HERE, "Cannot move launch plan to " + path));
+  }
+}
+
+std::optional<LaunchPlan>
+read_launch_plan(const std::string& path, const std::string& expected_hash)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::stringstream in;
+  in << file.rdbuf();
+  size_t max_size = in.str().size();
+
+  LaunchPlan plan;
+  std::string magic;
+  if (!read_string(in, magic, max_size) || magic != c_plan_magic || !read_string(in, plan.database_hash, max_size) ||
+      plan.database_hash != expected_hash) {
+    return std::nullopt;
+  }
+
+  size_t n_apps = 0;
+  if (!read_string(in, plan.session, max_size) || !read_string(in, plan.rte_script, max_size) ||
+      !read_size(in, n_apps, max_size)) {
+    return std::nullopt;
+  }
+  plan.apps.resize(n_apps);
+  for (auto& app : plan.apps) {
+    size_t n_env = 0;
+    if (!read_string(in, app.uid, max_size) || !read_string(in, app.host, max_size) ||
+        !read_string(in, app.application_name, max_size) || !read_size(in, n_env, max_size)) {
+      return std::nullopt;
+    }
+    for (size_t i = 0; i < n_env; ++i) {
+      std::string name, value;
+      if (!read_string(in, name, max_size) || !read_string(in, value, max_size)) {
+        return std::nullopt;
+      }
+      app.environment[name] = value;
+    }
+    size_t n_args = 0;
+    if (!read_size(in, n_args, max_size)) {
+      return std::nullopt;
+    }
+    app.commandline.resize(n_args);
+    for (auto& arg : app.commandline) {
+      if (!read_string(in, arg, max_size)) {
+        return std::nullopt;
+      }
+    }
+  }
+  return plan;
+}
+
+} // namespace dunedaq::appmodel
@@ -0,0 +1,165 @@
+#ifndef LINKBALANCING_HPP
+#define LINKBALANCING_HPP
+
+#include "CanonicalOrder.hpp"
+
+#include "appmodel/DPDKPortConfiguration.hpp"
+#include "appmodel/DPDKReceiver.hpp"
+#include "appmodel/GenerationDependencies.hpp"
+#include "appmodel/NWDetDataReceiver.hpp"
+#include "appmodel/NWDetDataSender.hpp"
+#include "appmodel/ReadoutApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include "conffwk/Configuration.hpp"
+#include "confmodel/DetectorStream.hpp"
+#include "confmodel/DetectorToDaqConnection.hpp"
+#include "confmodel/NetworkInterface.hpp"
+#include "confmodel/Session.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+struct LinkRoute
+{
+  const NWDetDataSender* sender;
+  const confmodel::NetworkInterface* destination;
+  uint16_t rx_queue;
+};
+
+/**
+ * Number of enabled DetectorStreams carried by a sender
+ */
+inline uint32_t
+enabled_stream_count(const NWDetDataSender* sender, const confmodel::Session* session)
+{
+  uint32_t count = 0;
+  for (auto res : sender->get_contains()) {
+    auto stream = res->cast<confmodel::DetectorStream>();
+    if (stream != nullptr && !stream->disabled(*session)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+/**
+ * Distribute the network links of a ReadoutApplication over all the
+ * receiver interfaces of its enabled DetectorToDaqConnections, balancing by
+ * link_rate_gbps. Links are placed fastest first on the least loaded
+ * interface, ties broken by UID, so every application generating from the
+ * same session gets the same routes. Streams are numbered on each interface
+ * in the order their links are placed, and each rx queue takes
+ * source_to_rx_queue_multiplexing of them; the rx_queue of a link is that of
+ * its first stream.
+ */
+inline std::vector<LinkRoute>
+balance_links(const ReadoutApplication* roapp, const confmodel::Session* session)
+{
+  std::map<std::string, const confmodel::NetworkInterface*> interfaces;
+  std::map<std::string, uint16_t> multiplexing;
+  std::vector<const NWDetDataSender*> senders;
+
+  for (auto d2d_conn_res : roapp->get_contains()) {
+    if (d2d_conn_res->disabled(*session)) {
+      continue;
+    }
+    auto d2d_conn = d2d_conn_res->cast<confmodel::DetectorToDaqConnection>();
+    if (!d2d_conn) {
+      continue;
+    }
+    auto nw_receiver = d2d_conn->get_receiver()->cast<NWDetDataReceiver>();
+    if (!nw_receiver) {
+      continue;
+    }
+    auto iface = nw_receiver->get_uses();
+    interfaces[iface->UID()] = iface;
+    uint16_t mux = 1;
+    if (auto dpdk_receiver = nw_receiver->cast<DPDKReceiver>()) {
+      mux = std::max<int16_t>(1, dpdk_receiver->get_configuration()->get_source_to_rx_queue_multiplexing());
+    }
+    multiplexing[iface->UID()] = mux;
+
+    for (auto sender : d2d_conn->get_senders()) {
+      auto nw_sender = sender->cast<NWDetDataSender>();
+      if (nw_sender) {
+        senders.push_back(nw_sender);
+      }
+    }
+  }
+
+  if (interfaces.empty()) {
+    throw(BadConf(ERS_HERE, "No network receiver interface to balance the links of " + roapp->UID() + " on"));
+  }
+
+  std::sort(senders.begin(), senders.end(), [](auto a, auto b) {
+    if (a->get_link_rate_gbps() != b->get_link_rate_gbps()) {
+      return a->get_link_rate_gbps() > b->get_link_rate_gbps();
+    }
+    return a->UID() < b->UID();
+  });
+
+  std::vector<const confmodel::NetworkInterface*> ifaces;
+  for (auto& [uid, iface] : interfaces) {
+    ifaces.push_back(iface);
+  }
+  std::vector<double> load(ifaces.size(), 0.);
+  std::vector<uint32_t> n_streams(ifaces.size(), 0);
+
+  std::vector<LinkRoute> routes;
+  for (auto sender : senders) {
+    size_t idx = std::min_element(load.begin(), load.end()) - load.begin();
+    load[idx] += sender->get_link_rate_gbps();
+    uint16_t rx_queue = n_streams[idx] / multiplexing[ifaces[idx]->UID()];
+    n_streams[idx] += enabled_stream_count(sender, session);
+    routes.push_back({ sender, ifaces[idx], rx_queue });
+  }
+  return routes;
+}
+
+/**
+ * The enabled ReadoutApplication of the session that contains a
+ * DetectorToDaqConnection, or nullptr
+ */
+inline const ReadoutApplication*
+owning_readout_application(const confmodel::DetectorToDaqConnection* d2d_conn, const confmodel::Session* session)
+{
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto roapp = app->cast<ReadoutApplication>();
+    if (roapp == nullptr) {
+      continue;
+    }
+    for (auto res : roapp->get_contains()) {
+      if (res->UID() == d2d_conn->UID()) {
+        return roapp;
+      }
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Create the NWLinkRoute objects for a set of routes, in the same order
+ */
+inline void
+create_link_route_objs(conffwk::Configuration* config,
+                       const std::string& dbfile,
+                       const std::vector<LinkRoute>& routes,
+                       std::vector<conffwk::ConfigObject>& route_objs)
+{
+  route_objs.resize(routes.size());
+  for (size_t i = 0; i < routes.size(); ++i) {
+    config->create(dbfile, "NWLinkRoute", "linkroute-" + routes[i].sender->UID(), route_objs[i]);
+    route_objs[i].set_obj("sender", &routes[i].sender->config_object());
+    route_objs[i].set_obj("destination", &routes[i].destination->config_object());
+    route_objs[i].set_by_val<uint16_t>("rx_queue", routes[i].rx_queue);
+  }
+}
+
+} // namespace dunedaq::appmodel
+#endif // LINKBALANCING_HPP
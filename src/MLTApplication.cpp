@@ -8,7 +8,12 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
+#include "Colocation.hpp"
+#include "ConfigObjectArena.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
+#include "appmodel/GenerationDependencies.hpp"
 
 #include "conffwk/Configuration.hpp"
 
@@ -86,11 +91,12 @@ conffwk::ConfigObject
 create_mlt_network_connection(std::string uid,
                               const NetworkConnectionDescriptor* ntDesc,
                               conffwk::Configuration* confdb,
-                              const std::string& dbfile)
+                              const std::string& dbfile,
+                              const std::string& ntClass = "NetworkConnection")
 {
   auto ntServiceObj = ntDesc->get_associated_service()->config_object();
   conffwk::ConfigObject ntObj;
-  confdb->create(dbfile, "NetworkConnection", uid, ntObj);
+  confdb->create(dbfile, ntClass, uid, ntObj);
   ntObj.set_by_val<std::string>("data_type", ntDesc->get_data_type());
   ntObj.set_by_val<std::string>("connection_type", ntDesc->get_connection_type());
   ntObj.set_obj("associated_service", &ntServiceObj);
@@ -103,6 +109,10 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
                                  const std::string& dbfile,
                                  const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   // auto mlt_conf = get_mlt_conf();
@@ -119,20 +129,12 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
     throw(BadConf(ERS_HERE, "No MLT configuration in MLTApplication given"));
   }
 
+  RuleIndex rules(this);
+
   // Queue descriptors
-  // Process the queue rules looking for inputs to our trigger handler modules
-  const QueueDescriptor* tc_inputq_desc = nullptr;
-  const QueueDescriptor* td_outputq_desc = nullptr;
-
-  for (auto rule : get_queue_rules()) {
-    auto destination_class = rule->get_destination_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-    if (destination_class == tch_class) {
-      tc_inputq_desc = rule->get_descriptor();
-    } else if (destination_class == mlt_class) {
-      td_outputq_desc = rule->get_descriptor();
-    }
-  }
+  // Inputs to our trigger handler modules
+  const QueueDescriptor* tc_inputq_desc = rules.queue_to(tch_class);
+  const QueueDescriptor* td_outputq_desc = rules.queue_to(mlt_class);
 
   if (tc_inputq_desc == nullptr) {
     throw(BadConf(ERS_HERE, "No TC input queue descriptor given"));
@@ -158,35 +160,12 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
   output_queue_obj.set_by_val<std::string>("queue_type", td_outputq_desc->get_queue_type());
   output_queue_obj.set_by_val<uint32_t>("capacity", td_outputq_desc->get_capacity());
 
-  // Net descriptors
-  const NetworkConnectionDescriptor* req_net_desc = nullptr;
-  const NetworkConnectionDescriptor* tc_net_desc = nullptr;
-  const NetworkConnectionDescriptor* ti_net_desc = nullptr;
-  const NetworkConnectionDescriptor* td_net_desc = nullptr;
-  const NetworkConnectionDescriptor* timesync_net_desc = nullptr;
-
-  for (auto rule : get_network_rules()) {
-    std::string data_type = rule->get_descriptor()->get_data_type();
-
-    // Network connections for the MLT
-    if (data_type == "TriggerInhibit") {
-      ti_net_desc = rule->get_descriptor();
-    }
-    if (data_type == "TriggerDecision") {
-      td_net_desc = rule->get_descriptor();
-    }
-    if (data_type == "TriggerCandidate") {
-      tc_net_desc = rule->get_descriptor();
-    }
-    if (data_type == "TimeSync") {
-      timesync_net_desc = rule->get_descriptor();
-    }
-    if (data_type == "DataRequest") {
-      req_net_desc = rule->get_descriptor();
-    }
-
-    TLOG_DEBUG(3) << "Endpoint class (currently not used in for networkconnections): data_type: " << data_type;
-  }
+  // Net descriptors, the endpoint class is currently not used for network connections
+  const NetworkConnectionDescriptor* req_net_desc = rules.network("DataRequest");
+  const NetworkConnectionDescriptor* tc_net_desc = rules.network("TriggerCandidate");
+  const NetworkConnectionDescriptor* ti_net_desc = rules.network("TriggerInhibit");
+  const NetworkConnectionDescriptor* td_net_desc = rules.network("TriggerDecision");
+  const NetworkConnectionDescriptor* timesync_net_desc = rules.network("TimeSync");
 
   if (!td_net_desc) {
     throw(BadConf(ERS_HERE, "No MLT network connection for the output TriggerDecision given"));
@@ -214,7 +193,11 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
 
   // Network conection for the input Data Requests
   conffwk::ConfigObject dr_net_obj =
-    create_mlt_network_connection(req_net_desc->get_uid_base() + UID(), req_net_desc, confdb, dbfile);
+    create_mlt_network_connection(req_net_desc->get_uid_base() + UID(),
+                                  req_net_desc,
+                                  confdb,
+                                  dbfile,
+                                  data_request_connection_class(req_net_desc, this, session));
 
   conffwk::ConfigObject timesync_net_obj;
   if (timesync_net_desc != nullptr) {
@@ -268,14 +251,17 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
    * Create the readout map
    **************************************************************/
 
-  std::vector<const dunedaq::confmodel::Application*> apps = session->get_enabled_applications();
+  std::vector<const dunedaq::confmodel::Application*> apps = enabled_applications(session);
 
+  // The SourceIDConf objects created below are referenced through sourceIds
+  ConfigObjectArena sourceIdObjs;
   std::vector<const conffwk::ConfigObject*> sourceIds;
 
   for (auto app : apps) {
+    GenerationDependencies::note_read(app);
     auto ro_app = app->cast<appmodel::ReadoutApplication>();
     if (ro_app != nullptr) {
-      auto resources = ro_app->get_contains();
+      auto resources = sorted_by_uid(ro_app->get_contains());
       // Interate over all the readout groups
       for (auto d2d_conn_res : resources) {
         if (d2d_conn_res->disabled(*session)) {
@@ -294,7 +280,7 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
         }
 
         // Interate over all the streams
-        for (auto stream : d2d_conn->get_streams()) {
+        for (auto stream : sorted_by_source_id(d2d_conn->get_streams())) {
           if (stream == nullptr) {
             throw(BadConf(ERS_HERE, "ReadoutInterface contains something other than DetectorStream"));
           }
@@ -305,13 +291,12 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
 
           // Create SourceIDConf object for the MLT
           auto id = stream->get_source_id();
-          conffwk::ConfigObject* sourceIdConf = new conffwk::ConfigObject();
           std::string sourceIdConfUID = "dro-mlt-stream-config-" + std::to_string(id);
-          confdb->create(dbfile, "SourceIDConf", sourceIdConfUID, *sourceIdConf);
-          sourceIdConf->set_by_val<uint32_t>("sid", id);
+          auto& sourceIdConf = sourceIdObjs.create(confdb, dbfile, "SourceIDConf", sourceIdConfUID);
+          sourceIdConf.set_by_val<uint32_t>("sid", id);
           // https://github.com/DUNE-DAQ/daqdataformats/blob/5b99506675a586c8a09123900e224f2371d96df9/include/daqdataformats/detail/SourceID.hxx#L108
-          sourceIdConf->set_by_val<std::string>("subsystem", "Detector_Readout");
-          sourceIds.push_back(sourceIdConf);
+          sourceIdConf.set_by_val<std::string>("subsystem", "Detector_Readout");
+          sourceIds.push_back(&sourceIdConf);
         }
       }
       if (ro_app->get_tp_generation_enabled()) {
@@ -329,7 +314,7 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
     auto fd_app = app->cast<appmodel::FakeDataApplication>();
     if (fd_app != nullptr) {
 
-      auto resources = fd_app->get_contains();
+      auto resources = sorted_by_uid(fd_app->get_contains());
       // Interate over all the FakeDataProd modules
       for (auto stream_res : resources) {
 
@@ -341,14 +326,14 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
         auto stream = stream_res->cast<appmodel::FakeDataProdConf>();
 
         // Create SourceIDConf object for the MLT
-        auto id = stream->get_source_id();
-        conffwk::ConfigObject* sourceIdConf = new conffwk::ConfigObject();
-        std::string sourceIdConfUID = "dro-mlt-stream-config-" + std::to_string(id);
-        confdb->create(dbfile, "SourceIDConf", sourceIdConfUID, *sourceIdConf);
-        sourceIdConf->set_by_val<uint32_t>("sid", id);
-        // https://github.com/DUNE-DAQ/daqdataformats/blob/5b99506675a586c8a09123900e224f2371d96df9/include/daqdataformats/detail/SourceID.hxx#L108
-        sourceIdConf->set_by_val<std::string>("subsystem", "Detector_Readout");
-        sourceIds.push_back(sourceIdConf);
+        for (auto id : stream->source_ids()) {
+          std::string sourceIdConfUID = "dro-mlt-stream-config-" + std::to_string(id);
+          auto& sourceIdConf = sourceIdObjs.create(confdb, dbfile, "SourceIDConf", sourceIdConfUID);
+          sourceIdConf.set_by_val<uint32_t>("sid", id);
+          // https://github.com/DUNE-DAQ/daqdataformats/blob/5b99506675a586c8a09123900e224f2371d96df9/include/daqdataformats/detail/SourceID.hxx#L108
+          sourceIdConf.set_by_val<std::string>("subsystem", "Detector_Readout");
+          sourceIds.push_back(&sourceIdConf);
+        }
       }
     }
 
@@ -356,40 +341,40 @@ MLTApplication::generate_modules(conffwk::Configuration* confdb,
     // source somehow...
     auto trg_app = app->cast<appmodel::TriggerApplication>();
     if (trg_app != nullptr && trg_app->get_source_id() != nullptr) {
-      conffwk::ConfigObject* tcSourceIdConf = new conffwk::ConfigObject();
-      confdb->create(dbfile,
-                     "SourceIDConf",
-                     trg_app->UID() + "-" + std::to_string(trg_app->get_source_id()->get_sid()),
-                     *tcSourceIdConf);
-      tcSourceIdConf->set_by_val<uint32_t>("sid", trg_app->get_source_id()->get_sid());
-      tcSourceIdConf->set_by_val<std::string>("subsystem", trg_app->get_source_id()->get_subsystem());
-      sourceIds.push_back(tcSourceIdConf);
+      auto& tcSourceIdConf =
+        sourceIdObjs.create(confdb,
+                            dbfile,
+                            "SourceIDConf",
+                            trg_app->UID() + "-" + std::to_string(trg_app->get_source_id()->get_sid()));
+      tcSourceIdConf.set_by_val<uint32_t>("sid", trg_app->get_source_id()->get_sid());
+      tcSourceIdConf.set_by_val<std::string>("subsystem", trg_app->get_source_id()->get_subsystem());
+      sourceIds.push_back(&tcSourceIdConf);
     }
 
     // FIXME: add here same logics for HSI application(s)
     //
     auto hsi_app = app->cast<appmodel::FakeHSIApplication>();
     if (hsi_app != nullptr && hsi_app->get_source_id() != nullptr) {
-      conffwk::ConfigObject* hsEventSourceIdConf = new conffwk::ConfigObject();
-      confdb->create(dbfile,
-                     "SourceIDConf",
-                     hsi_app->UID() + "-" + std::to_string(hsi_app->get_source_id()->get_sid()),
-                     *hsEventSourceIdConf);
-      hsEventSourceIdConf->set_by_val<uint32_t>("sid", hsi_app->get_source_id()->get_sid());
-      hsEventSourceIdConf->set_by_val<std::string>("subsystem", hsi_app->get_source_id()->get_subsystem());
-      sourceIds.push_back(hsEventSourceIdConf);
+      auto& hsEventSourceIdConf =
+        sourceIdObjs.create(confdb,
+                            dbfile,
+                            "SourceIDConf",
+                            hsi_app->UID() + "-" + std::to_string(hsi_app->get_source_id()->get_sid()));
+      hsEventSourceIdConf.set_by_val<uint32_t>("sid", hsi_app->get_source_id()->get_sid());
+      hsEventSourceIdConf.set_by_val<std::string>("subsystem", hsi_app->get_source_id()->get_subsystem());
+      sourceIds.push_back(&hsEventSourceIdConf);
     }
 
     auto dts_hsi_app = app->cast<appmodel::DTSHSIApplication>();
     if (dts_hsi_app != nullptr && dts_hsi_app->get_source_id() != nullptr) {
-      conffwk::ConfigObject* hsEventSourceIdConf = new conffwk::ConfigObject();
-      confdb->create(dbfile,
-                     "SourceIDConf",
-                     dts_hsi_app->UID() + "-" + std::to_string(dts_hsi_app->get_source_id()->get_sid()),
-                     *hsEventSourceIdConf);
-      hsEventSourceIdConf->set_by_val<uint32_t>("sid", dts_hsi_app->get_source_id()->get_sid());
-      hsEventSourceIdConf->set_by_val<std::string>("subsystem", dts_hsi_app->get_source_id()->get_subsystem());
-      sourceIds.push_back(hsEventSourceIdConf);
+      auto& hsEventSourceIdConf =
+        sourceIdObjs.create(confdb,
+                            dbfile,
+                            "SourceIDConf",
+                            dts_hsi_app->UID() + "-" + std::to_string(dts_hsi_app->get_source_id()->get_sid()));
+      hsEventSourceIdConf.set_by_val<uint32_t>("sid", dts_hsi_app->get_source_id()->get_sid());
+      hsEventSourceIdConf.set_by_val<std::string>("subsystem", dts_hsi_app->get_source_id()->get_subsystem());
+      sourceIds.push_back(&hsEventSourceIdConf);
     }
   }
 
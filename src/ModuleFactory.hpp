@@ -4,6 +4,7 @@
 #include "logging/Logging.hpp"
 #include "appmodel/appmodelIssues.hpp"
 
+#include <filesystem>
 #include <functional>
 #include <map>
 #include <mutex>
@@ -12,6 +13,8 @@
 
 #include "confmodel/DaqModule.hpp"
 #include "confmodel/Session.hpp"
+#include "appmodel/FrozenModuleSet.hpp"
+#include "appmodel/LaunchPlan.hpp"
 #include "appmodel/SmartDaqApplication.hpp"
 #include "conffwk/Configuration.hpp"
 
@@ -104,5 +107,40 @@ namespace dunedaq::appmodel {
 
   }; // ModuleFactory
 
+  /**
+   * The FrozenModuleSet written for app by freeze_generated_modules, if the
+   * database holds one. Generators return its modules instead of generating.
+   * If the database files the modules were frozen from are readable and
+   * their hash has changed, the frozen modules are stale and BadConf is
+   * thrown: generating again is not possible in a database that already
+   * holds the frozen objects, or in a slice that lacks the rest of the
+   * session.
+   */
+  inline const FrozenModuleSet* frozen_module_set(const SmartDaqApplication* app,
+                                                  conffwk::Configuration* confdb,
+                                                  const confmodel::Session* session) {
+    auto frozen = confdb->get<FrozenModuleSet>("frozen-" + app->UID());
+    if (frozen == nullptr || frozen->get_application()->UID() != app->UID()) {
+      return nullptr;
+    }
+
+    auto& files = frozen->get_database_files();
+    bool readable = !files.empty();
+    for (auto& file : files) {
+      readable = readable && std::filesystem::is_regular_file(file);
+    }
+    if (readable && database_hash(files, session->UID()) != frozen->get_database_hash()) {
+      throw(BadConf(ERS_HERE,
+                    "Frozen modules of " + app->UID() + " do not match database " + files.front() +
+                      " and session " + session->UID() + " any more, they must be frozen again"));
+    }
+    if (!readable) {
+      TLOG_DEBUG(6) << "Database files of the frozen modules of " << app->UID() << " not available, hash not checked";
+    }
+
+    TLOG_DEBUG(6) << "Using " << frozen->get_modules().size() << " frozen modules for " << app->UID();
+    return frozen;
+  }
+
 } // namespace dunedaq::appmodel
 #endif // MODULEFACTORY
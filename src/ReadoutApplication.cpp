@@ -8,7 +8,12 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
+#include "Colocation.hpp"
+#include "ConfigObjectArena.hpp"
+#include "LinkBalancing.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
 
 #include "appmodel/DFApplication.hpp"
 #include "appmodel/ReadoutApplication.hpp"
@@ -40,18 +45,32 @@
 #include "appmodel/DataHandlerModule.hpp"
 #include "appmodel/DataHandlerConf.hpp"
 #include "appmodel/FragmentAggregatorModule.hpp"
+#include "appmodel/GenerationDependencies.hpp"
 #include "appmodel/NetworkConnectionDescriptor.hpp"
 #include "appmodel/NetworkConnectionRule.hpp"
 #include "appmodel/QueueConnectionRule.hpp"
 #include "appmodel/QueueDescriptor.hpp"
 #include "appmodel/RequestHandler.hpp"
+#include "appmodel/StreamEmulationParameters.hpp"
+#include "appmodel/TPStreamWriterApplication.hpp"
+#include "appmodel/TPStreamWriterConf.hpp"
+
+#include "appmodel/AVXFrugalPedestalSubtractProcessor.hpp"
+#include "appmodel/AVXRunSumProcessor.hpp"
+#include "appmodel/AVXThresholdProcessor.hpp"
+#include "appmodel/ProcessingStep.hpp"
+#include "appmodel/RawDataProcessor.hpp"
 
 #include "appmodel/appmodelIssues.hpp"
 
 #include "logging/Logging.hpp"
 #include <fmt/core.h>
 
+#include <algorithm>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 // using namespace dunedaq;
@@ -77,7 +96,7 @@ class ReadoutObjFactory {
     conffwk::ConfigObject queue_obj;
 
     std::string queue_uid(qdesc->get_uid_base());
-    config->create(this->dbfile, "Queue", queue_uid, queue_obj);
+    config->create(this->dbfile, qdesc->connection_class(), queue_uid, queue_obj);
     queue_obj.set_by_val<std::string>("data_type", qdesc->get_data_type());
     queue_obj.set_by_val<std::string>("queue_type", qdesc->get_queue_type());
     queue_obj.set_by_val<uint32_t>("capacity", qdesc->get_capacity());
@@ -89,6 +108,10 @@ class ReadoutObjFactory {
   conffwk::ConfigObject create_queue_sid_obj(const QueueDescriptor* qdesc, uint32_t src_id) {
     conffwk::ConfigObject queue_obj;
 
+    if (qdesc->get_transfer_mode() != "kCopy") {
+      throw(BadConf(ERS_HERE, fmt::format("Queue descriptor {} with source id does not support transfer mode {}", qdesc->UID(), qdesc->get_transfer_mode())));
+    }
+
     std::string queue_uid(fmt::format("{}{}", qdesc->get_uid_base(), src_id));
     config->create(this->dbfile, "QueueWithSourceId", queue_uid, queue_obj);
     queue_obj.set_by_val<std::string>("data_type", qdesc->get_data_type());
@@ -107,12 +130,12 @@ class ReadoutObjFactory {
 
 
   //---
-  conffwk::ConfigObject create_net_obj(const NetworkConnectionDescriptor* ndesc, std::string uid) {
+  conffwk::ConfigObject create_net_obj(const NetworkConnectionDescriptor* ndesc, std::string uid, const std::string& net_class) {
     conffwk::ConfigObject net_obj;
 
     auto svc_obj = ndesc->get_associated_service()->config_object();
     std::string net_id = ndesc->get_uid_base() + uid;
-    config->create(this->dbfile, "NetworkConnection", net_id, net_obj);
+    config->create(this->dbfile, net_class, net_id, net_obj);
     net_obj.set_by_val<std::string>("data_type", ndesc->get_data_type());
     net_obj.set_by_val<std::string>("connection_type", ndesc->get_connection_type());
     net_obj.set_obj("associated_service", &svc_obj);
@@ -121,6 +144,10 @@ class ReadoutObjFactory {
 
   }
 
+  conffwk::ConfigObject create_net_obj(const NetworkConnectionDescriptor* ndesc, std::string uid) {
+    return this->create_net_obj(ndesc, uid, ndesc->connection_class());
+  }
+
   conffwk::ConfigObject create_net_obj(const NetworkConnectionDescriptor* ndesc) {
     return this->create_net_obj(ndesc, this->app_uid);
   }
@@ -128,10 +155,181 @@ class ReadoutObjFactory {
 
 };
 
+//-----------------------------------------------------------------------------
+//
+// Validation of the RawDataProcessor processing chain
+//
+// The vectorised hit finding expects the steps in the order pedestal
+// subtraction -> running sum filters -> threshold. Chains in another order
+// are put in that order, keeping the order of the running sums, and handed
+// to the link handlers through processing_order. A step without an AVX
+// implementation makes the processor fall back to the scalar code path, so
+// such chains are rejected at generation time.
+//
+enum class ProcessingStage { kPedestal = 0, kFilter = 1, kThreshold = 2, kUnknown = 3 };
+
+static ProcessingStage
+processing_stage(const ProcessingStep* step)
+{
+  // AVXFixedPedestalSubtractProcessor derives from the frugal one
+  if (step->cast<AVXFrugalPedestalSubtractProcessor>()) {
+    return ProcessingStage::kPedestal;
+  }
+  // AVXAbsRunSumProcessor derives from the plain running sum
+  if (step->cast<AVXRunSumProcessor>()) {
+    return ProcessingStage::kFilter;
+  }
+  if (step->cast<AVXThresholdProcessor>()) {
+    return ProcessingStage::kThreshold;
+  }
+  return ProcessingStage::kUnknown;
+}
+
+// Planes defined by the TPC channel maps the hit finding is used with
+static const std::map<std::string, std::set<uint32_t>> s_channel_map_planes = {
+  { "HDColdboxChannelMap", { 0, 1, 2 } },
+  { "ICEBERGChannelMap", { 0, 1, 2 } },
+  { "PD2HDChannelMap", { 0, 1, 2 } },
+  { "PD2VDBottomTPCChannelMap", { 0, 1, 2 } },
+  { "PD2VDTopTPCChannelMap", { 0, 1, 2 } },
+  { "VDColdboxChannelMap", { 0, 1, 2 } },
+};
+
+// Parameters of the step for each of the planes 0, 1 and 2, empty if the
+// step has no per-plane parameters
+static std::vector<std::vector<uint32_t>>
+plane_parameters(const ProcessingStep* step)
+{
+  if (auto rs = step->cast<AVXRunSumProcessor>()) {
+    return { { rs->get_memory_factor_plane0(), rs->get_scale_factor_plane0() },
+             { rs->get_memory_factor_plane1(), rs->get_scale_factor_plane1() },
+             { rs->get_memory_factor_plane2(), rs->get_scale_factor_plane2() } };
+  }
+  if (auto th = step->cast<AVXThresholdProcessor>()) {
+    return { { th->get_plane0() }, { th->get_plane1() }, { th->get_plane2() } };
+  }
+  return {};
+}
+
+// Per-plane parameters that differ between planes need a channel map
+// defining those planes; a plane the map does not define must not be given
+// its own values
+static void
+check_plane_parameters(const RawDataProcessor* proc, const ProcessingStep* step)
+{
+  auto params = plane_parameters(step);
+  if (params.empty() || std::all_of(params.begin(), params.end(), [&](auto& p) { return p == params.front(); })) {
+    return;
+  }
+  auto it = s_channel_map_planes.find(proc->get_channel_map());
+  if (it == s_channel_map_planes.end()) {
+    throw(BadConf(ERS_HERE, fmt::format("Processing step {} has per-plane parameters but channel map '{}' of {} "
+                                        "does not define planes", step->UID(), proc->get_channel_map(), proc->UID())));
+  }
+  auto& planes = it->second;
+  for (uint32_t plane = 0; plane < params.size(); ++plane) {
+    if (planes.count(plane)) {
+      continue;
+    }
+    for (auto defined : planes) {
+      if (defined < params.size() && params[plane] != params[defined]) {
+        throw(BadConf(ERS_HERE, fmt::format("Processing step {} sets plane {} which channel map {} of {} does not "
+                                            "define", step->UID(), plane, proc->get_channel_map(), proc->UID())));
+      }
+    }
+  }
+}
+
+struct ProcessingChain
+{
+  // Steps in pedestal subtraction -> running sums -> threshold order
+  std::vector<const ProcessingStep*> steps;
+  // Fused-kernel hints
+  std::vector<std::string> hints;
+};
+
+// Puts the chain in canonical order and finds the fusable steps, throws
+// BadConf if the chain is not usable
+static ProcessingChain
+check_processing_chain(const RawDataProcessor* proc)
+{
+  ProcessingChain chain;
+  chain.steps = proc->get_processing_steps();
+  if (chain.steps.empty()) {
+    throw(BadConf(ERS_HERE, fmt::format("RawDataProcessor {} has no processing steps", proc->UID())));
+  }
+
+  for (auto step : chain.steps) {
+    if (processing_stage(step) == ProcessingStage::kUnknown) {
+      throw(BadConf(ERS_HERE, fmt::format("Processing step {} of class {} in {} has no vectorised implementation",
+                                          step->UID(), step->class_name(), proc->UID())));
+    }
+    check_plane_parameters(proc, step);
+  }
+
+  auto by_stage = [](const ProcessingStep* a, const ProcessingStep* b) {
+    return processing_stage(a) < processing_stage(b);
+  };
+  if (!std::is_sorted(chain.steps.begin(), chain.steps.end(), by_stage)) {
+    std::stable_sort(chain.steps.begin(), chain.steps.end(), by_stage);
+    TLOG_DEBUG(6) << "Processing steps of " << proc->UID()
+                  << " put in pedestal subtraction, running sums, threshold order";
+  }
+
+  const ProcessingStep* last_step = nullptr;
+  for (auto step : chain.steps) {
+    auto stage = processing_stage(step);
+    if (last_step != nullptr && stage != ProcessingStage::kFilter && processing_stage(last_step) == stage) {
+      throw(BadConf(ERS_HERE, fmt::format("Processing step {} in {} duplicates the {} stage", step->UID(), proc->UID(),
+                                          stage == ProcessingStage::kPedestal ? "pedestal subtraction" : "threshold")));
+    }
+
+    // Pedestal subtraction directly followed by the threshold, or a running sum
+    // directly followed by the threshold, can be run as one kernel pass
+    if (last_step != nullptr && stage == ProcessingStage::kThreshold) {
+      chain.hints.push_back(fmt::format("fuse:{}+{}", last_step->UID(), step->UID()));
+    }
+    last_step = step;
+  }
+
+  return chain;
+}
+
+// TPSet time slice of the session, taken from the TPStreamWriterConf of its
+// enabled TPStreamWriterApplications so that publishers and writers agree
+static uint64_t
+session_tpset_time_slice(const confmodel::Session* session)
+{
+  uint64_t slice = 0;
+  const TPStreamWriterApplication* first = nullptr;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto tpwapp = app->cast<TPStreamWriterApplication>();
+    if (tpwapp == nullptr || tpwapp->get_tp_writer() == nullptr) {
+      continue;
+    }
+    auto app_slice = tpwapp->get_tp_writer()->get_tpset_time_slice_ticks();
+    if (first != nullptr && app_slice != slice) {
+      throw(BadConf(ERS_HERE,
+                    fmt::format("TPStreamWriterApplications {} and {} use different tpset_time_slice_ticks ({} and {})",
+                                first->UID(),
+                                tpwapp->UID(),
+                                slice,
+                                app_slice)));
+    }
+    first = tpwapp;
+    slice = app_slice;
+  }
+  return slice;
+}
+
 //-----------------------------------------------------------------------------
 std::vector<const confmodel::DaqModule*>
 ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::string& dbfile, const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, config, session)) {
+    return frozen->get_modules();
+  }
 
   TLOG_DEBUG(6) << "Generating modules for application " << this->UID();
 
@@ -161,53 +359,46 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
     tph_class = tph_conf->get_template_for();
   }
 
+  // Check the hit finding chain of the link handlers before generating anything
+  ProcessingChain processing_chain;
+  if (get_tp_generation_enabled()) {
+    auto raw_proc = dlh_conf->get_data_processor()->cast<RawDataProcessor>();
+    if (raw_proc != nullptr) {
+      processing_chain = check_processing_chain(raw_proc);
+    }
+  }
+  std::vector<std::string> processing_order;
+  for (auto step : processing_chain.steps) {
+    processing_order.push_back(step->UID());
+  }
+
+  RuleIndex rules(this);
+
   //
-  // Process the queue rules looking for inputs to our DL/TP handler modules
+  // Inputs to our DL/TP handler modules
   //
-  const QueueDescriptor* dlh_input_qdesc = nullptr;
-  const QueueDescriptor* dlh_reqinput_qdesc = nullptr;
+  const QueueDescriptor* dlh_reqinput_qdesc = rules.queue("DataRequest", { dlh_class, tph_class, "DataHandlerModule" });
   const QueueDescriptor* tp_input_qdesc = nullptr;
-  // const QueueDescriptor* tpReqInputQDesc = nullptr;
-  const QueueDescriptor* fa_output_qdesc = nullptr;
-
-  for (auto rule : get_queue_rules()) {
-    auto destination_class = rule->get_destination_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-    // Why datahander here?
-    if (destination_class == "DataHandlerModule" || destination_class == dlh_class || destination_class == tph_class) {
-      if (data_type == "DataRequest") {
-        dlh_reqinput_qdesc = rule->get_descriptor();
-      } else if (data_type == "TriggerPrimitive" && get_tp_generation_enabled()) {
-        tp_input_qdesc = rule->get_descriptor();
-      } else {
-        dlh_input_qdesc = rule->get_descriptor();
-      }
-    } else if (destination_class == "FragmentAggregatorModule") {
-      fa_output_qdesc = rule->get_descriptor();
-    }
+  if (get_tp_generation_enabled()) {
+    tp_input_qdesc = rules.queue("TriggerPrimitive", { dlh_class, tph_class, "DataHandlerModule" });
+  }
+  const QueueDescriptor* fa_output_qdesc = rules.queue_to("FragmentAggregatorModule");
+
+  // The raw data input is the last handler queue of any other data type
+  std::vector<std::string> non_raw_data_types{ "DataRequest" };
+  if (get_tp_generation_enabled()) {
+    non_raw_data_types.push_back("TriggerPrimitive");
   }
+  const QueueDescriptor* dlh_input_qdesc =
+    rules.queue_to_except({ dlh_class, tph_class, "DataHandlerModule" }, non_raw_data_types);
 
   //
-  // Process the network rules looking for the Fragment Aggregator and TP handler data reuest inputs
+  // The Fragment Aggregator and TP handler data request inputs
   //
-  const NetworkConnectionDescriptor* fa_net_desc = nullptr;
-  const NetworkConnectionDescriptor* tp_net_desc = nullptr;
-  const NetworkConnectionDescriptor* ta_net_desc = nullptr;
-  const NetworkConnectionDescriptor* ts_net_desc = nullptr;
-  for (auto rule : get_network_rules()) {
-    auto endpoint_class = rule->get_endpoint_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-
-    if (endpoint_class == "FragmentAggregatorModule") {
-      fa_net_desc = rule->get_descriptor();
-    } else if (data_type == "TPSet") {
-      tp_net_desc = rule->get_descriptor();
-    } else if (data_type == "TriggerActivity") {
-      ta_net_desc = rule->get_descriptor();
-    } else if (data_type == "TimeSync") {
-      ts_net_desc = rule->get_descriptor();
-    }
-  }
+  const NetworkConnectionDescriptor* fa_net_desc = rules.network_to("FragmentAggregatorModule");
+  const NetworkConnectionDescriptor* tp_net_desc = rules.network("TPSet");
+  const NetworkConnectionDescriptor* ta_net_desc = rules.network("TriggerActivity");
+  const NetworkConnectionDescriptor* ts_net_desc = rules.network("TimeSync");
 
   // Create here the Queue on which all data fragments are forwarded to the fragment aggregator
   // and a container for the queues of data request to TP handler and DLH
@@ -230,7 +421,7 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
   std::vector<const confmodel::DetectorStream*> det_streams;
   std::vector<const conffwk::ConfigObject*> d2d_conn_objs;
 
-  for (auto d2d_conn_res : get_contains()) {
+  for (auto d2d_conn_res : sorted_by_uid(get_contains())) {
 
     // Are we sure?
     if (d2d_conn_res->disabled(*session)) {
@@ -290,6 +481,9 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
     }
   }
 
+  // Queues and handlers are created in source id order
+  det_streams = sorted_by_source_id(std::move(det_streams));
+
   //-----------------------------------------------------------------
   //
   // Create DataReaderModule object
@@ -311,11 +505,35 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
   reader_obj.set_obj("configuration", &reader_conf->config_object());
   reader_obj.set_objs("connections", d2d_conn_objs);
 
+  // Spread the links over all receiver interfaces; WIECApplication computes the same routes for the senders
+  std::vector<conffwk::ConfigObject> link_route_objs;
+  if (get_balance_links()) {
+    if (reader_class != "DPDKReaderModule") {
+      throw(BadConf(ERS_HERE, fmt::format("balance_links requires a DPDKReaderModule, found {}", reader_class)));
+    }
+    create_link_route_objs(config, dbfile, balance_links(this, session), link_route_objs);
+    std::vector<const conffwk::ConfigObject*> link_routes;
+    for (auto& obj : link_route_objs) {
+      link_routes.push_back(&obj);
+    }
+    reader_obj.set_objs("link_routes", link_routes);
+  }
+
   // Create the raw data queues
   std::vector<const conffwk::ConfigObject*> data_queue_objs;
   // keep a map for convenience
   std::map<uint32_t, const confmodel::Connection*> data_queues_by_sid;
 
+  // Queues and handlers are named after the source id, which must be unique
+  std::map<uint32_t, const confmodel::DetectorStream*> streams_by_sid;
+  for (auto ds : det_streams) {
+    auto [it, inserted] = streams_by_sid.emplace(ds->get_source_id(), ds);
+    if (!inserted) {
+      throw(BadConf(ERS_HERE, fmt::format("DetectorStreams {} and {} have the same source id {}",
+                                          it->second->UID(), ds->UID(), ds->get_source_id())));
+    }
+  }
+
   // Create data queues
   for (auto ds : det_streams) {
     conffwk::ConfigObject queue_obj = obj_fac.create_queue_sid_obj(dlh_input_qdesc, ds);
@@ -326,6 +544,40 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
 
   reader_obj.set_objs("outputs", data_queue_objs);
 
+  // With memory-mapped replay all streams share one mapping of the input
+  // file and start at staggered offsets, instead of each loading a copy
+  auto emu_conf = reader_conf->get_emulation_conf();
+  std::vector<conffwk::ConfigObject> replay_objs;
+  conffwk::ConfigObject mapped_input_obj;
+  if (reader_conf->get_emulation_mode() && emu_conf != nullptr && emu_conf->get_replay_mode() == "kMemoryMapped") {
+    if (emu_conf->get_data_file_name().empty()) {
+      throw(BadConf(ERS_HERE, fmt::format("No data_file_name given in {} for memory-mapped replay", emu_conf->UID())));
+    }
+    if (emu_conf->get_rate_scale() <= 0.) {
+      throw(BadConf(ERS_HERE, fmt::format("rate_scale of {} must be positive", emu_conf->UID())));
+    }
+    config->create(dbfile, "MappedInputFile", fmt::format("mappedinput-{}", reader_uid), mapped_input_obj);
+    mapped_input_obj.set_by_val<std::string>("file_name", emu_conf->get_data_file_name());
+
+    std::vector<uint32_t> replay_sids;
+    for (auto ds : det_streams) {
+      replay_sids.push_back(ds->get_source_id());
+    }
+    std::sort(replay_sids.begin(), replay_sids.end());
+
+    replay_objs.resize(replay_sids.size());
+    std::vector<const conffwk::ConfigObject*> replay_obj_ptrs;
+    for (size_t i = 0; i < replay_sids.size(); ++i) {
+      config->create(dbfile, "StreamReplayConf", fmt::format("streamreplay-{}", replay_sids[i]), replay_objs[i]);
+      replay_objs[i].set_by_val<uint32_t>("source_id", replay_sids[i]);
+      replay_objs[i].set_by_val<uint64_t>("offset", i * emu_conf->get_stream_offset_stride());
+      replay_objs[i].set_by_val<double>("rate_scale", emu_conf->get_rate_scale());
+      replay_objs[i].set_obj("input", &mapped_input_obj);
+      replay_obj_ptrs.push_back(&replay_objs[i]);
+    }
+    reader_obj.set_objs("stream_replay", replay_obj_ptrs);
+  }
+
   modules.push_back(config->get<confmodel::DaqModule>(reader_uid));
 
   //-----------------------------------------------------------------
@@ -337,6 +589,7 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
 
     // Create TP handler object
     auto tph_conf_obj = tph_conf->config_object();
+    auto tpset_slice = session_tpset_time_slice(session);
     auto tpsrc_ids = get_tp_source_ids();
 
     for (auto sid : tpsrc_ids) {
@@ -349,6 +602,7 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
       tph_obj.set_by_val<uint32_t>("detector_id", 1); // 1 == kDAQ
       tph_obj.set_by_val<bool>("post_processing_enabled", get_ta_generation_enabled());
       tph_obj.set_obj("module_configuration", &tph_conf_obj);
+      tph_obj.set_by_val<uint64_t>("tpset_time_slice_ticks", tpset_slice);
 
       // Create the TPs aggregator queue (from RawData Handlers to TP handlers)
       tp_queue_obj = obj_fac.create_queue_sid_obj(tp_input_qdesc, sid->get_sid());
@@ -361,10 +615,12 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
       req_queues.push_back(config->get<confmodel::Connection>(tpreq_queue_obj.UID()));
 
       // Create the tp(set) publishing service
-      conffwk::ConfigObject tp_net_obj = obj_fac.create_net_obj(tp_net_desc, tp_uid);
+      conffwk::ConfigObject tp_net_obj = obj_fac.create_net_obj(
+        tp_net_desc, tp_uid, publication_connection_class(tp_net_desc, this, tp_net_desc->get_uid_base() + tp_uid, session));
 
       // Create the ta(set) publishing service
-      conffwk::ConfigObject ta_net_obj = obj_fac.create_net_obj(ta_net_desc, tp_uid);
+      conffwk::ConfigObject ta_net_obj = obj_fac.create_net_obj(
+        ta_net_desc, tp_uid, publication_connection_class(ta_net_desc, this, ta_net_desc->get_uid_base() + tp_uid, session));
 
       // Register queues with tp hankder
       tph_obj.set_objs("inputs", { &tp_queue_obj, &tpreq_queue_obj });
@@ -397,6 +653,8 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
     dlh_obj.set_by_val<uint32_t>("detector_id", ds->get_geo_id()->get_detector_id());
     dlh_obj.set_by_val<bool>("post_processing_enabled", get_tp_generation_enabled());
     dlh_obj.set_by_val<bool>("emulation_mode", emulation_mode);
+    dlh_obj.set_by_val<std::vector<std::string>>("processing_order", processing_order);
+    dlh_obj.set_by_val<std::vector<std::string>>("processing_hints", processing_chain.hints);
     dlh_obj.set_obj("geo_id", &ds->get_geo_id()->config_object());
     dlh_obj.set_obj("module_configuration", &dlh_conf->config_object());
 
@@ -439,13 +697,16 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
   config->create(dbfile, "FragmentAggregatorModule", faUid, frag_aggr);
 
   // Add network connection from TRBs
-  conffwk::ConfigObject fa_net_obj = obj_fac.create_net_obj(fa_net_desc);
+  conffwk::ConfigObject fa_net_obj =
+    obj_fac.create_net_obj(fa_net_desc, UID(), data_request_connection_class(fa_net_desc, this, session));
 
   // Process special Network rules!
   // Looking for Fragment rules from DFAppplications in current Session
-  auto sessionApps = session->get_enabled_applications();
-  std::vector<conffwk::ConfigObject> fragOutObjs;
+  auto sessionApps = enabled_applications(session);
+  ConfigObjectArena fragOutObjs;
+  std::vector<const conffwk::ConfigObject*> fa_output_objs;
   for (auto app : sessionApps) {
+    GenerationDependencies::note_read(app);
     auto dfapp = app->cast<appmodel::DFApplication>();
     if (dfapp == nullptr)
       continue;
@@ -455,26 +716,25 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
       auto descriptor = rule->get_descriptor();
       auto data_type = descriptor->get_data_type();
       if (data_type == "Fragment") {
-        std::string dreqNetUid(descriptor->get_uid_base() + dfapp->UID());
-        conffwk::ConfigObject frag_conn;
-        config->create(dbfile, "NetworkConnection", dreqNetUid, frag_conn);
+        std::string dreqNetUid(fragment_connection_uid(descriptor, dfapp, this));
+        auto& frag_conn = fragOutObjs.create(config,
+                                             dbfile,
+                                             fragments_over_shared_memory(descriptor, dfapp, this)
+                                               ? "SharedMemoryConnection"
+                                               : descriptor->connection_class(),
+                                             dreqNetUid);
 
         frag_conn.set_by_val<std::string>("data_type", descriptor->get_data_type());
         frag_conn.set_by_val<std::string>("connection_type", descriptor->get_connection_type());
 
         auto serviceObj = descriptor->get_associated_service()->config_object();
         frag_conn.set_obj("associated_service", &serviceObj);
-        fragOutObjs.push_back(frag_conn);
+        fa_output_objs.push_back(&frag_conn);
       } // If network rule has TriggerDecision type of data
     }   // Loop over Apps network rules
   }     // loop over Session specific Apps
 
-  // Add output queueus of data requests and Fragments
-  std::vector<const conffwk::ConfigObject*> fa_output_objs;
-  for (auto& fNet : fragOutObjs) {
-    fa_output_objs.push_back(&fNet);
-  }
-
+  // Add output queueus of data requests
   for (auto& q : req_queues) {
     fa_output_objs.push_back(&q->config_object());
   }
@@ -484,6 +744,60 @@ ReadoutApplication::generate_modules(conffwk::Configuration* config, const std::
 
   modules.push_back(config->get<confmodel::DaqModule>(frag_aggr.UID()));
 
+  // The first request concentrating application of a host also receives the
+  // DataRequests for the others and forwards them by source id
+  auto host = physical_host_uid(this);
+  auto concentration_groups = request_concentration_groups(session);
+  if (get_request_concentration() && concentration_groups.count(host) &&
+      concentration_groups[host].front() == this) {
+    auto& group = concentration_groups[host];
+    conffwk::ConfigObject host_net_obj = obj_fac.create_net_obj(fa_net_desc, concentrator_connection_suffix(host));
+
+    std::vector<std::vector<uint32_t>> app_source_ids;
+    for (auto roapp : group) {
+      app_source_ids.push_back(readout_stream_source_ids(roapp));
+    }
+
+    ConfigObjectArena group_objs;
+    std::vector<const conffwk::ConfigObject*> outputs;
+    std::vector<const conffwk::ConfigObject*> request_connections;
+    for (size_t i = 0; i < group.size(); ++i) {
+      // The leader's own DataRequest connection is the one of its FragmentAggregator
+      auto& app_net_obj = group[i] == this ? fa_net_obj
+                                           : group_objs.add(obj_fac.create_net_obj(
+                                               fa_net_desc,
+                                               group[i]->UID(),
+                                               data_request_connection_class(fa_net_desc, group[i], session)));
+
+      std::vector<const conffwk::ConfigObject*> source_id_objs;
+      for (auto sid : app_source_ids[i]) {
+        auto& sid_obj =
+          group_objs.create(config, dbfile, "SourceIDConf", group[i]->UID() + "SourceIDConf" + std::to_string(sid));
+        sid_obj.set_by_val<uint32_t>("sid", sid);
+        sid_obj.set_by_val<std::string>("subsystem", "Detector_Readout");
+        source_id_objs.push_back(&sid_obj);
+      }
+      for (auto tp_sid : group[i]->get_tp_source_ids()) {
+        source_id_objs.push_back(&tp_sid->config_object());
+      }
+      auto& sid_net_obj = group_objs.create(config, dbfile, "SourceIDToNetworkConnection", app_net_obj.UID() + "-sids");
+      sid_net_obj.set_objs("source_ids", source_id_objs);
+      sid_net_obj.set_obj("netconn", &app_net_obj);
+
+      outputs.push_back(&app_net_obj);
+      request_connections.push_back(&sid_net_obj);
+    }
+
+    std::string rc_uid("requestconcentrator-" + host);
+    conffwk::ConfigObject rc_obj;
+    TLOG_DEBUG(7) << "creating OKS configuration object for RequestConcentratorModule on host " << host;
+    config->create(dbfile, "RequestConcentratorModule", rc_uid, rc_obj);
+    rc_obj.set_objs("inputs", { &host_net_obj });
+    rc_obj.set_objs("outputs", outputs);
+    rc_obj.set_objs("request_connections", request_connections);
+    modules.push_back(config->get<confmodel::DaqModule>(rc_uid));
+  }
+
   return modules;
 }
 
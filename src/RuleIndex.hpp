@@ -0,0 +1,154 @@
+#ifndef RULEINDEX_HPP
+#define RULEINDEX_HPP
+
+#include "appmodel/NetworkConnectionDescriptor.hpp"
+#include "appmodel/NetworkConnectionRule.hpp"
+#include "appmodel/QueueConnectionRule.hpp"
+#include "appmodel/QueueDescriptor.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::appmodel {
+
+/**
+ * The queue and network rules of a SmartDaqApplication indexed by data type
+ * and destination (queues) or endpoint (networks) class, built once at the
+ * start of generate_modules.
+ *
+ * As with the loops over the rules it replaces, the last matching rule wins
+ * when several rules match. An empty data type or class matches any.
+ */
+class RuleIndex
+{
+public:
+  explicit RuleIndex(const SmartDaqApplication* app)
+  {
+    size_t rule_index = 0;
+    for (auto rule : app->get_queue_rules()) {
+      auto descriptor = rule->get_descriptor();
+      add(m_queues, descriptor->get_data_type(), rule->get_destination_class(), { rule_index++, descriptor });
+      m_queues_in_order.push_back({ rule->get_destination_class(), descriptor });
+    }
+    rule_index = 0;
+    for (auto rule : app->get_network_rules()) {
+      auto descriptor = rule->get_descriptor();
+      add(m_networks, descriptor->get_data_type(), rule->get_endpoint_class(), { rule_index++, descriptor });
+    }
+  }
+
+  // Queue descriptor for data_type sent to destination_class, or nullptr
+  const QueueDescriptor* queue(const std::string& data_type, const std::string& destination_class) const
+  {
+    return find(m_queues, data_type, destination_class).second;
+  }
+
+  // As above, for the last rule matching any of the destination classes;
+  // empty classes are skipped
+  const QueueDescriptor* queue(const std::string& data_type,
+                               std::initializer_list<std::string> destination_classes) const
+  {
+    return find_last(m_queues, data_type, destination_classes);
+  }
+
+  // Queue descriptor of any data type sent to destination_class, or nullptr
+  const QueueDescriptor* queue_to(const std::string& destination_class) const
+  {
+    return queue("", destination_class);
+  }
+
+  // Queue descriptor of the last rule sent to any of the destination classes
+  // whose data type is not one of excluded_data_types, or nullptr
+  const QueueDescriptor* queue_to_except(std::initializer_list<std::string> destination_classes,
+                                         const std::vector<std::string>& excluded_data_types) const
+  {
+    for (auto it = m_queues_in_order.rbegin(); it != m_queues_in_order.rend(); ++it) {
+      auto& [rule_class, descriptor] = *it;
+      if (!rule_class.empty() &&
+          std::find(destination_classes.begin(), destination_classes.end(), rule_class) != destination_classes.end() &&
+          std::find(excluded_data_types.begin(), excluded_data_types.end(), descriptor->get_data_type()) ==
+            excluded_data_types.end()) {
+        return descriptor;
+      }
+    }
+    return nullptr;
+  }
+
+  // Network descriptor for data_type with endpoint_class, or nullptr
+  const NetworkConnectionDescriptor* network(const std::string& data_type,
+                                             const std::string& endpoint_class = "") const
+  {
+    return find(m_networks, data_type, endpoint_class).second;
+  }
+
+  // As above, for the last rule matching any of the endpoint classes;
+  // empty classes are skipped
+  const NetworkConnectionDescriptor* network(const std::string& data_type,
+                                             std::initializer_list<std::string> endpoint_classes) const
+  {
+    return find_last(m_networks, data_type, endpoint_classes);
+  }
+
+  // Network descriptor of any data type with endpoint_class, or nullptr
+  const NetworkConnectionDescriptor* network_to(const std::string& endpoint_class) const
+  {
+    return network("", endpoint_class);
+  }
+
+private:
+  // Position of the rule in the application's rule list and its descriptor
+  template<typename T>
+  using Entry = std::pair<size_t, const T*>;
+
+  template<typename T>
+  using Index = std::unordered_map<std::string, Entry<T>>;
+
+  static std::string key(const std::string& data_type, const std::string& cls) { return data_type + '\n' + cls; }
+
+  // Rules are added in order, so each key keeps the last rule matching it
+  template<typename T>
+  static void add(Index<T>& index, const std::string& data_type, const std::string& cls, const Entry<T>& entry)
+  {
+    index[key(data_type, cls)] = entry;
+    index[key(data_type, "")] = entry;
+    index[key("", cls)] = entry;
+  }
+
+  template<typename T>
+  static Entry<T> find(const Index<T>& index, const std::string& data_type, const std::string& cls)
+  {
+    auto it = index.find(key(data_type, cls));
+    return it != index.end() ? it->second : Entry<T>{ 0, nullptr };
+  }
+
+  template<typename T>
+  static const T* find_last(const Index<T>& index,
+                            const std::string& data_type,
+                            std::initializer_list<std::string> classes)
+  {
+    Entry<T> last{ 0, nullptr };
+    for (auto& cls : classes) {
+      if (cls.empty()) {
+        continue;
+      }
+      auto entry = find(index, data_type, cls);
+      if (entry.second != nullptr && (last.second == nullptr || entry.first > last.first)) {
+        last = entry;
+      }
+    }
+    return last.second;
+  }
+
+  Index<QueueDescriptor> m_queues;
+  Index<NetworkConnectionDescriptor> m_networks;
+  std::vector<std::pair<std::string, const QueueDescriptor*>> m_queues_in_order;
+};
+
+} // namespace dunedaq::appmodel
+
+#endif // RULEINDEX_HPP
@@ -10,6 +10,10 @@ std::vector<const dunedaq::confmodel::DaqModule*>
 SmartDaqApplication::generate_modules(conffwk::Configuration* confdb,
                                       const std::string& dbfile,
                                       const confmodel::Session* session) const {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   oks::OksFile::set_nolock_mode(true);
   return ModuleFactory::instance().generate(class_name(),
                                             this,
@@ -8,7 +8,12 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
+#include "Colocation.hpp"
+#include "ConfigObjectArena.hpp"
+#include "HDF5WriteTuning.hpp"
 #include "ModuleFactory.hpp"
+#include "RuleIndex.hpp"
 
 #include "conffwk/Configuration.hpp"
 #include "oks/kernel.hpp"
@@ -20,11 +25,14 @@
 #include "appmodel/TPStreamWriterConf.hpp"
 #include "appmodel/NetworkConnectionRule.hpp"
 #include "appmodel/NetworkConnectionDescriptor.hpp"
+#include "appmodel/DataStoreConf.hpp"
+#include "appmodel/GenerationDependencies.hpp"
 #include "appmodel/ReadoutApplication.hpp"
 #include "appmodel/SourceIDConf.hpp"
 #include "appmodel/appmodelIssues.hpp"
 #include "logging/Logging.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -44,11 +52,37 @@ __reg__("TPStreamWriterApplication", [] (const SmartDaqApplication* smartApp,
   }
   );
 
+namespace {
+// Source ids of the TP handlers of all enabled ReadoutApplications, i.e. the
+// TPSet publishers, in ascending order
+std::vector<uint32_t>
+tp_publisher_source_ids(const confmodel::Session* session)
+{
+  std::vector<uint32_t> sids;
+  for (auto app : enabled_applications(session)) {
+    GenerationDependencies::note_read(app);
+    auto roapp = app->cast<ReadoutApplication>();
+    if (roapp == nullptr || !roapp->get_tp_generation_enabled()) {
+      continue;
+    }
+    for (auto sid : roapp->get_tp_source_ids()) {
+      sids.push_back(sid->get_sid());
+    }
+  }
+  std::sort(sids.begin(), sids.end());
+  return sids;
+}
+} // namespace
+
 std::vector<const confmodel::DaqModule*> 
 TPStreamWriterApplication::generate_modules(conffwk::Configuration* confdb,
                                             const std::string& dbfile,
-                                            const confmodel::Session* /*session*/) const
+                                            const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   auto tpwriterConf = get_tp_writer();
@@ -57,41 +91,100 @@ TPStreamWriterApplication::generate_modules(conffwk::Configuration* confdb,
   }
   auto tpwriterConfObj = tpwriterConf->config_object();
 
-  const NetworkConnectionDescriptor* tset_in_net_desc = nullptr;
-  for (auto rule : get_network_rules()) {
-    auto endpoint_class = rule->get_endpoint_class();
-    auto data_type = rule->get_descriptor()->get_data_type();
-    if (data_type == "TPSet") {
-      tset_in_net_desc = rule->get_descriptor();
-    }
+  // Accumulation intervals must be made of whole TPSet slices
+  auto slice = tpwriterConf->get_tpset_time_slice_ticks();
+  if (slice != 0 && tpwriterConf->get_tp_accumulation_interval() % slice != 0) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("tp_accumulation_interval {} of {} is not a multiple of tpset_time_slice_ticks {}",
+                              tpwriterConf->get_tp_accumulation_interval(),
+                              tpwriterConf->UID(),
+                              slice)));
   }
+
+  const NetworkConnectionDescriptor* tset_in_net_desc = RuleIndex(this).network("TPSet");
   if ( tset_in_net_desc== nullptr) {
       throw (BadConf(ERS_HERE, "No network descriptor given to receive TPSets"));
   }
-  // Create Network Connection
-  conffwk::ConfigObject tset_in_net_obj;
-  auto tset_in_service_obj = tset_in_net_desc->get_associated_service()->config_object();
-  std::string tset_stream_uid(tset_in_net_desc->get_uid_base()+".*");
-  confdb->create(dbfile, "NetworkConnection", tset_stream_uid, tset_in_net_obj);
-  tset_in_net_obj.set_by_val<std::string>("data_type", tset_in_net_desc->get_data_type());
-  tset_in_net_obj.set_by_val<std::string>("connection_type", tset_in_net_desc->get_connection_type());
-  tset_in_net_obj.set_obj("associated_service", &tset_in_service_obj);
-
-  conffwk::ConfigObject tpwrObj;
 
   auto source_id = get_source_id();
   if (source_id == nullptr) {
     throw(BadConf(ERS_HERE, "No SourceIDConf given to TPWriterApplication!"));  
   }
 
-  std::string tpwrUid("tpwriter-"+std::to_string(source_id->get_sid()));
-  confdb->create(dbfile, "TPStreamWriterModule", tpwrUid, tpwrObj);
-  tpwrObj.set_by_val<uint32_t>("source_id", source_id->get_sid());
-  tpwrObj.set_by_val("writer_identifier", fmt::format("{}_tpw_{}", UID(), source_id->get_sid()));
-  tpwrObj.set_obj("configuration", &tpwriterConf->config_object());
-  tpwrObj.set_objs("inputs", {&tset_in_net_obj} );
+  auto n_writers = get_number_of_writers();
+  if (n_writers == 0) {
+    throw(BadConf(ERS_HERE, "number_of_writers of " + UID() + " must be at least 1"));
+  }
+  auto shard_stores = get_shard_data_stores();
+  if (!shard_stores.empty() && shard_stores.size() != n_writers) {
+    throw(BadConf(ERS_HERE,
+                  fmt::format("{} has {} shard_data_stores for {} writers", UID(), shard_stores.size(), n_writers)));
+  }
+
+  // The subscription uid is a pattern on the uids of the TPSet publishers,
+  // which ReadoutApplication names <uid_base>tphandler-<sid>. It is anchored
+  // at the end so that e.g. sid 1 does not also match tphandler-12
+  std::vector<std::string> tset_stream_uids;
+  if (n_writers == 1) {
+    tset_stream_uids.push_back(tset_in_net_desc->get_uid_base() + ".*");
+  }
+  else {
+    auto sids = tp_publisher_source_ids(session);
+    if (sids.size() < n_writers) {
+      throw(BadConf(ERS_HERE,
+                    fmt::format("{} has {} writers but the session only has {} TP publishers",
+                                UID(),
+                                n_writers,
+                                sids.size())));
+    }
+    for (uint32_t shard = 0; shard < n_writers; ++shard) {
+      std::string pattern;
+      for (size_t i = shard * sids.size() / n_writers; i < (shard + 1) * sids.size() / n_writers; ++i) {
+        pattern += (pattern.empty() ? "" : "|") + std::to_string(sids[i]);
+      }
+      tset_stream_uids.push_back(tset_in_net_desc->get_uid_base() + "tphandler-(" + pattern + ")$");
+    }
+  }
 
-  modules.push_back(confdb->get<TPStreamWriterModule>(tpwrUid));
+  auto tset_in_service_obj = tset_in_net_desc->get_associated_service()->config_object();
+  ConfigObjectArena shmObjs;
+  for (uint32_t shard = 0; shard < n_writers; ++shard) {
+    // Create Network Connection
+    conffwk::ConfigObject tset_in_net_obj;
+    confdb->create(dbfile, "NetworkConnection", tset_stream_uids[shard], tset_in_net_obj);
+    tset_in_net_obj.set_by_val<std::string>("data_type", tset_in_net_desc->get_data_type());
+    tset_in_net_obj.set_by_val<std::string>("connection_type", tset_in_net_desc->get_connection_type());
+    tset_in_net_obj.set_obj("associated_service", &tset_in_service_obj);
+
+    conffwk::ConfigObject tpwrObj;
+    std::string tpwrUid("tpwriter-" + std::to_string(source_id->get_sid()));
+    std::string writerId(fmt::format("{}_tpw_{}", UID(), source_id->get_sid()));
+    if (n_writers > 1) {
+      tpwrUid += "-" + std::to_string(shard);
+      writerId += "_" + std::to_string(shard);
+    }
+    confdb->create(dbfile, "TPStreamWriterModule", tpwrUid, tpwrObj);
+    tpwrObj.set_by_val<uint32_t>("source_id", source_id->get_sid());
+    tpwrObj.set_by_val("writer_identifier", writerId);
+    tpwrObj.set_obj("configuration", &tpwriterConf->config_object());
+    auto store = tpwriterConf->get_data_store_params();
+    if (!shard_stores.empty()) {
+      store = shard_stores[shard];
+      tpwrObj.set_obj("data_store_params", &store->config_object());
+    }
+    // There is no description of the TP writer storage: buffered I/O on 4 kB blocks
+    conffwk::ConfigObject writeParamsObj;
+    if (create_hdf5_write_params(confdb, dbfile, tpwrUid, store, false, 4096, writeParamsObj)) {
+      tpwrObj.set_obj("write_params", &writeParamsObj);
+    }
+    // Publishers on this host whose subscribers are all here publish over shared memory
+    auto inputObjs = shared_memory_subscriptions(
+      confdb, dbfile, session, tset_in_net_desc->get_data_type(), tset_stream_uids[shard], shmObjs);
+    inputObjs.insert(inputObjs.begin(), &tset_in_net_obj);
+    tpwrObj.set_objs("inputs", inputObjs);
+
+    modules.push_back(confdb->get<TPStreamWriterModule>(tpwrUid));
+  }
 
   return modules;
 }
@@ -8,6 +8,8 @@
  * received with this code.
  */
 
+#include "Colocation.hpp"
+#include "ConfigObjectArena.hpp"
 #include "ModuleFactory.hpp"
 
 #include "conffwk/Configuration.hpp"
@@ -82,8 +84,12 @@ create_network_connection(std::string uid,
 std::vector<const confmodel::DaqModule*>
 TriggerApplication::generate_modules(conffwk::Configuration* confdb,
                                      const std::string& dbfile,
-                                     const confmodel::Session* /*session*/) const
+                                     const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, confdb, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   auto ti_conf = get_trigger_inputs_handler();
@@ -179,7 +185,7 @@ TriggerApplication::generate_modules(conffwk::Configuration* confdb,
 
   auto req_service_obj = req_net_desc->get_associated_service()->config_object();
   std::string req_net_uid(req_net_desc->get_uid_base()+UID());;
-  confdb->create(dbfile, "NetworkConnection", req_net_uid, req_net_obj);
+  confdb->create(dbfile, data_request_connection_class(req_net_desc, this, session), req_net_uid, req_net_obj);
   req_net_obj.set_by_val<std::string>("connection_type", req_net_desc->get_connection_type());
   req_net_obj.set_by_val<std::string>("data_type", req_net_desc->get_data_type());
   req_net_obj.set_obj("associated_service", &req_service_obj);
@@ -244,7 +250,12 @@ TriggerApplication::generate_modules(conffwk::Configuration* confdb,
   conffwk::ConfigObject reader_obj;
   TLOG_DEBUG(7) <<  "creating OKS configuration object for Data subscriber class " << reader_class;
   confdb->create(dbfile, reader_class, reader_uid, reader_obj);
-  reader_obj.set_objs("inputs", {&tin_net_obj} );
+  // Publishers on this host whose subscribers are all here publish over shared memory
+  ConfigObjectArena shm_objs;
+  auto reader_inputs =
+    shared_memory_subscriptions(confdb, dbfile, session, tin_net_desc->get_data_type(), t_in_stream_uid, shm_objs);
+  reader_inputs.insert(reader_inputs.begin(), &tin_net_obj);
+  reader_obj.set_objs("inputs", reader_inputs);
   reader_obj.set_objs("outputs", {&input_queue_obj} );
   reader_obj.set_obj("configuration", &rdr_conf->config_object());
 
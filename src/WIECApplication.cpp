@@ -8,6 +8,8 @@
  * received with this code.
  */
 
+#include "CanonicalOrder.hpp"
+#include "LinkBalancing.hpp"
 #include "ModuleFactory.hpp"
 
 #include "conffwk/Configuration.hpp"
@@ -29,6 +31,7 @@
 #include "confmodel/DetectorToDaqConnection.hpp"
 
 
+#include <map>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -48,18 +51,65 @@ __reg__("WIECApplication", [] (const SmartDaqApplication* smartApp,
   }
   );
 
+// Assign each control host to a configuration group. Hosts of the same
+// configuration domain go to different groups, and no group holds more than
+// batch_size hosts (if not 0). Hosts are visited in name order so the result
+// is reproducible.
+static std::map<std::string, uint32_t>
+assign_configuration_groups(const std::map<std::string, std::vector<const appmodel::HermesDataSender*>>& ctrlhost_sender_map,
+                            uint32_t batch_size)
+{
+  std::map<std::string, uint32_t> groups;
+  std::map<std::string, uint32_t> next_group_in_domain;
+  std::vector<uint32_t> group_sizes;
+
+  for (const auto& [ctrlhost, senders] : ctrlhost_sender_map) {
+    std::string domain = senders.front()->get_configuration_domain();
+    for (const auto* sndr : senders) {
+      if (sndr->get_configuration_domain() != domain) {
+        throw(BadConf(ERS_HERE, fmt::format("Senders of control host {} are in different configuration domains", ctrlhost)));
+      }
+    }
+
+    uint32_t group = 0;
+    if (!domain.empty()) {
+      group = next_group_in_domain[domain];
+    }
+    while (batch_size != 0 && group < group_sizes.size() && group_sizes[group] >= batch_size) {
+      ++group;
+    }
+    if (group >= group_sizes.size()) {
+      group_sizes.resize(group + 1, 0);
+    }
+    ++group_sizes[group];
+    groups[ctrlhost] = group;
+    if (!domain.empty()) {
+      next_group_in_domain[domain] = group + 1;
+    }
+  }
+  return groups;
+}
+
 std::vector<const confmodel::DaqModule*> 
 WIECApplication::generate_modules(conffwk::Configuration* config,
                                             const std::string& dbfile,
                                             const confmodel::Session* session) const
 {
+  if (auto frozen = frozen_module_set(this, config, session)) {
+    return frozen->get_modules();
+  }
+
   std::vector<const confmodel::DaqModule*> modules;
 
   std::map<std::string, std::vector<const appmodel::HermesDataSender*>> ctrlhost_sender_map;
+  std::map<std::string, const appmodel::NWDetDataReceiver*> ctrlhost_receiver_map;
+  // Routes of the links whose ReadoutApplication balances them over its interfaces
+  std::map<std::string, std::vector<LinkRoute>> balanced_routes;
+  std::map<std::string, LinkRoute> sender_routes;
 
 
   // uint16_t conn_idx = 0;
-  for (auto d2d_conn_res : get_contains()) {
+  for (auto d2d_conn_res : sorted_by_uid(get_contains())) {
 
     // Are we sure?
     if (d2d_conn_res->disabled(*session)) {
@@ -88,7 +138,15 @@ WIECApplication::generate_modules(conffwk::Configuration* config,
     if ( !nw_receiver ) {
       throw(BadConf(ERS_HERE, fmt::format("WEICApplication requires NWDetDataReceiver, found {} of class {}", det_receiver->UID(), det_receiver->class_name())));
     }
-  
+
+    auto roapp = owning_readout_application(d2d_conn, session);
+    if (roapp != nullptr && roapp->get_balance_links() && !balanced_routes.count(roapp->UID())) {
+      balanced_routes[roapp->UID()] = balance_links(roapp, session);
+      for (const auto& route : balanced_routes[roapp->UID()]) {
+        sender_routes.emplace(route.sender->UID(), route);
+      }
+    }
+
     // Loop over senders
     for (const auto* sender : det_senders) {
 
@@ -99,43 +157,69 @@ WIECApplication::generate_modules(conffwk::Configuration* config,
       }
 
       ctrlhost_sender_map[hrms_sender->get_control_host()].push_back(hrms_sender);
+
+      // A Hermes core sends all its links to one destination, unless they are routed individually
+      auto [it, inserted] = ctrlhost_receiver_map.emplace(hrms_sender->get_control_host(), nw_receiver);
+      if (!inserted && it->second->get_uses() != nw_receiver->get_uses() && !sender_routes.count(hrms_sender->UID())) {
+        throw(BadConf(ERS_HERE, fmt::format("Control host {} sends to more than one network interface", hrms_sender->get_control_host())));
+      }
     }
+  }
 
+  auto configuration_groups = assign_configuration_groups(ctrlhost_sender_map, get_configuration_batch_size());
 
-    for( const auto& [ctrlhost, senders] : ctrlhost_sender_map ) {
+  for (const auto& [ctrlhost, senders] : ctrlhost_sender_map) {
+    uint32_t group = configuration_groups[ctrlhost];
 
-      // Create WIBModule
-      if ( this->get_wib_module_conf() ) {
-        conffwk::ConfigObject wib_obj;
-        std::string wib_uid = fmt::format("wib-ctrl-{}-{}", this->UID(), ctrlhost);
-        config->create(dbfile, "WIBModule", wib_uid, wib_obj);
-        wib_obj.set_by_val<std::string>("wib_addr", fmt::format("{}://{}:{}", this->get_wib_module_conf()->get_communication_type(), ctrlhost, this->get_wib_module_conf()->get_communication_port()));
-        wib_obj.set_obj("conf", &this->get_wib_module_conf()->get_settings()->config_object());
-        modules.push_back(config->get<appmodel::WIBModule>(wib_obj));
-      }
+    // Create WIBModule
+    if (this->get_wib_module_conf()) {
+      conffwk::ConfigObject wib_obj;
+      std::string wib_uid = fmt::format("wib-ctrl-{}-{}", this->UID(), ctrlhost);
+      config->create(dbfile, "WIBModule", wib_uid, wib_obj);
+      wib_obj.set_by_val<std::string>("wib_addr", fmt::format("{}://{}:{}", this->get_wib_module_conf()->get_communication_type(), ctrlhost, this->get_wib_module_conf()->get_communication_port()));
+      wib_obj.set_by_val<uint32_t>("configuration_group", group);
+      wib_obj.set_obj("conf", &this->get_wib_module_conf()->get_settings()->config_object());
+      modules.push_back(config->get<appmodel::WIBModule>(wib_obj));
+    }
 
-      // Create Hermes Modules
-      if (this->get_hermes_module_conf()) {
-        conffwk::ConfigObject hermes_obj;
-        std::string hermes_uid = fmt::format("hermes-ctrl-{}-{}", this->UID(), ctrlhost);
-        config->create(dbfile, "HermesModule", hermes_uid, hermes_obj);
-        hermes_obj.set_obj("address_table", &this->get_hermes_module_conf()->get_address_table()->config_object());
-        hermes_obj.set_by_val<std::string>("uri", fmt::format("{}://{}:{}", this->get_hermes_module_conf()->get_ipbus_type(), ctrlhost, this->get_hermes_module_conf()->get_ipbus_port()));
-        hermes_obj.set_by_val<uint32_t>("timeout_ms", this->get_hermes_module_conf()->get_ipbus_timeout_ms());
-        hermes_obj.set_obj("destination", &nw_receiver->get_uses()->config_object());
-
-        std::vector< const conffwk::ConfigObject * > links_obj; 
-        for ( const auto* sndr : senders ){
-          links_obj.push_back(&sndr->config_object());
+    // Create Hermes Modules
+    if (this->get_hermes_module_conf()) {
+      auto ipbus_timeout_ms = this->get_hermes_module_conf()->get_ipbus_timeout_ms();
+      conffwk::ConfigObject hermes_obj;
+      std::string hermes_uid = fmt::format("hermes-ctrl-{}-{}", this->UID(), ctrlhost);
+      config->create(dbfile, "HermesModule", hermes_uid, hermes_obj);
+      hermes_obj.set_obj("address_table", &this->get_hermes_module_conf()->get_address_table()->config_object());
+      hermes_obj.set_by_val<std::string>("uri", fmt::format("{}://{}:{}", this->get_hermes_module_conf()->get_ipbus_type(), ctrlhost, this->get_hermes_module_conf()->get_ipbus_port()));
+      hermes_obj.set_by_val<uint32_t>("timeout_ms", ipbus_timeout_ms);
+      hermes_obj.set_by_val<uint32_t>("configuration_group", group);
+      // One IPbus transaction budget for the core plus one per link
+      hermes_obj.set_by_val<uint32_t>("configuration_timeout_ms", static_cast<uint32_t>(ipbus_timeout_ms * (senders.size() + 1)));
+      hermes_obj.set_obj("destination", &ctrlhost_receiver_map[ctrlhost]->get_uses()->config_object());
+
+      std::vector<LinkRoute> routes;
+      for (const auto* sndr : senders) {
+        if (sender_routes.count(sndr->UID())) {
+          routes.push_back(sender_routes.at(sndr->UID()));
         }
-        hermes_obj.set_objs("links", links_obj);
-
-        modules.push_back(config->get<appmodel::HermesModule>(hermes_obj));
+      }
+      std::vector<conffwk::ConfigObject> route_objs;
+      if (!routes.empty()) {
+        create_link_route_objs(config, dbfile, routes, route_objs);
+        std::vector<const conffwk::ConfigObject*> link_routes;
+        for (auto& obj : route_objs) {
+          link_routes.push_back(&obj);
+        }
+        hermes_obj.set_objs("link_routes", link_routes);
       }
 
+      std::vector< const conffwk::ConfigObject * > links_obj; 
+      for ( const auto* sndr : senders ){
+        links_obj.push_back(&sndr->config_object());
+      }
+      hermes_obj.set_objs("links", links_obj);
 
+      modules.push_back(config->get<appmodel::HermesModule>(hermes_obj));
     }
-
   }
 
   return modules;
@@ -0,0 +1,268 @@
+/**
+ * @file generation_golden_test.cxx
+ *
+ * Regression test of the module generation: generates every enabled
+ * SmartDaqApplication of a session and compares the result with reference
+ * files
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2024.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "logging/Logging.hpp"
+
+#include "conffwk/Configuration.hpp"
+#include "conffwk/Schema.hpp"
+
+#include "confmodel/DaqModule.hpp"
+#include "confmodel/Session.hpp"
+
+#include "appmodel/ConfigSlice.hpp"
+#include "appmodel/SmartDaqApplication.hpp"
+#include "appmodel/appmodelIssues.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+
+namespace {
+
+std::string
+format_value(const std::string& value)
+{
+  return "\"" + value + "\"";
+}
+
+std::string
+format_value(bool value)
+{
+  return value ? "true" : "false";
+}
+
+template<typename T>
+std::string
+format_value(T value)
+{
+  std::ostringstream out;
+  out << +value;
+  return out.str();
+}
+
+std::string
+format_value(const conffwk::ConfigObject& value)
+{
+  return value.is_null() ? "-" : value.UID() + "@" + value.class_name();
+}
+
+template<typename T>
+std::string
+format_member(conffwk::ConfigObject& obj, const std::string& name, bool multi_value)
+{
+  if (!multi_value) {
+    T value;
+    obj.get(name, value);
+    return format_value(value);
+  }
+  std::vector<T> values;
+  obj.get(name, values);
+  std::string text = "[";
+  for (T value : values) {
+    text += (text.size() > 1 ? " " : "") + format_value(value);
+  }
+  return text + "]";
+}
+
+std::string
+format_attribute(conffwk::ConfigObject& obj, const conffwk::attribute_t& attr)
+{
+  switch (attr.p_type) {
+    case conffwk::bool_type: return format_member<bool>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::s8_type: return format_member<int8_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::u8_type: return format_member<uint8_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::s16_type: return format_member<int16_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::u16_type: return format_member<uint16_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::s32_type: return format_member<int32_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::u32_type: return format_member<uint32_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::s64_type: return format_member<int64_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::u64_type: return format_member<uint64_t>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::float_type: return format_member<float>(obj, attr.p_name, attr.p_is_multi_value);
+    case conffwk::double_type: return format_member<double>(obj, attr.p_name, attr.p_is_multi_value);
+    default: return format_member<std::string>(obj, attr.p_name, attr.p_is_multi_value);
+  }
+}
+
+// One "object uid@class" line, then one "  name: value" line per attribute
+// and relationship, sorted by name. Written here rather than with
+// print_ref so that the reference files only depend on this test.
+void
+print_object(std::ostream& out, conffwk::Configuration& confdb, conffwk::ConfigObject& obj)
+{
+  std::map<std::string, std::string> members;
+  auto& info = confdb.get_class_info(obj.class_name());
+  for (auto& attr : info.p_attributes) {
+    members[attr.p_name] = format_attribute(obj, attr);
+  }
+  for (auto& rel : info.p_relationships) {
+    bool multi_value = (rel.p_cardinality == conffwk::zero_or_many || rel.p_cardinality == conffwk::one_or_many);
+    members[rel.p_name] = format_member<conffwk::ConfigObject>(obj, rel.p_name, multi_value);
+  }
+  out << "object " << format_value(obj) << "\n";
+  for (auto& [name, value] : members) {
+    out << "  " << name << ": " << value << "\n";
+  }
+}
+
+// Canonical text form of the modules generated for one application: the
+// modules in generation order, then every generated object they reach,
+// sorted by name. The objects are generated into a scratch file including
+// the database, as freeze_generated_modules does, which is never committed.
+std::string
+generate(const std::string& dbfile, const std::string& sessionName, const std::string& appName)
+{
+  conffwk::Configuration confdb("oksconflibs:" + dbfile);
+  auto session = confdb.get<confmodel::Session>(sessionName);
+  auto app = confdb.get<appmodel::SmartDaqApplication>(appName);
+
+  auto gen_file = std::filesystem::weakly_canonical(std::filesystem::temp_directory_path() /
+                                                    ("generation_golden_test." + appName + ".data.xml"));
+  std::filesystem::remove(gen_file);
+  confdb.create(gen_file.string(), std::list<std::string>{ std::filesystem::absolute(dbfile).string() });
+
+  std::ostringstream out;
+  std::vector<conffwk::ConfigObject> roots;
+  for (auto module : app->generate_modules(&confdb, gen_file.string(), session)) {
+    out << "module " << module->UID() << "@" << module->class_name() << "\n";
+    roots.push_back(module->config_object());
+  }
+
+  std::vector<conffwk::ConfigObject> generated;
+  std::set<std::string> stop = { "Segment.segments", "Segment.applications", "Session.segment" };
+  for (auto& obj : appmodel::reference_closure(confdb, roots, stop)) {
+    if (!obj.contained_in().empty() && std::filesystem::weakly_canonical(obj.contained_in()) == gen_file) {
+      generated.push_back(obj);
+    }
+  }
+  std::sort(generated.begin(), generated.end(), [](auto& a, auto& b) { return a.full_name() < b.full_name(); });
+  for (auto& obj : generated) {
+    print_object(out, confdb, obj);
+  }
+
+  confdb.abort();
+  std::filesystem::remove(gen_file);
+  return out.str();
+}
+
+// First line where the two texts differ, or 0 if they are identical
+size_t
+first_difference(const std::string& a, const std::string& b, std::string& line_a, std::string& line_b)
+{
+  std::istringstream in_a(a), in_b(b);
+  for (size_t line = 1;; ++line) {
+    bool more_a = static_cast<bool>(std::getline(in_a, line_a));
+    bool more_b = static_cast<bool>(std::getline(in_b, line_b));
+    if (!more_a && !more_b) {
+      return 0;
+    }
+    if (more_a != more_b || line_a != line_b) {
+      return line;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    std::cout << "Usage: " << argv[0] << " <session> <database-file> <golden-dir> [--update]\n";
+    return 0;
+  }
+
+  std::string sessionName(argv[1]);
+  std::string dbfile(argv[2]);
+  std::filesystem::path goldenDir(argv[3]);
+  bool update = (argc > 4 && std::string(argv[4]) == "--update");
+
+  logging::Logging::setup("test", "generation_golden");
+
+  std::vector<std::string> appNames;
+  try {
+    conffwk::Configuration confdb("oksconflibs:" + dbfile);
+    auto session = confdb.get<confmodel::Session>(sessionName);
+    if (session == nullptr) {
+      std::cout << "Failed to get Session " << sessionName << " from database\n";
+      return -1;
+    }
+    for (auto app : session->get_enabled_applications()) {
+      if (app->cast<appmodel::SmartDaqApplication>() != nullptr) {
+        appNames.push_back(app->UID());
+      }
+    }
+  }
+  catch (conffwk::Generic& exc) {
+    std::cout << "Failed to load OKS database: " << exc << std::endl;
+    return -1;
+  }
+  std::sort(appNames.begin(), appNames.end());
+
+  int failures = 0;
+  for (auto& appName : appNames) {
+    std::string result;
+    try {
+      result = generate(dbfile, sessionName, appName);
+
+      // Generating twice must give the same result
+      if (generate(dbfile, sessionName, appName) != result) {
+        std::cout << "FAIL " << appName << ": generation is not deterministic" << std::endl;
+        ++failures;
+        continue;
+      }
+    }
+    catch (ers::Issue& exc) {
+      std::cout << "FAIL " << appName << ": " << exc << std::endl;
+      ++failures;
+      continue;
+    }
+
+    auto goldenFile = goldenDir / (sessionName + "." + appName + ".txt");
+    if (update) {
+      std::filesystem::create_directories(goldenDir);
+      std::ofstream(goldenFile) << result;
+      std::cout << "Updated " << goldenFile.string() << std::endl;
+      continue;
+    }
+
+    std::ifstream in(goldenFile);
+    if (!in) {
+      std::cout << "FAIL " << appName << ": no reference file " << goldenFile.string() << std::endl;
+      ++failures;
+      continue;
+    }
+    std::stringstream golden;
+    golden << in.rdbuf();
+
+    std::string expected, actual;
+    auto line = first_difference(golden.str(), result, expected, actual);
+    if (line != 0) {
+      std::cout << "FAIL " << appName << ": differs from " << goldenFile.string() << " at line " << line << "\n"
+                << "  expected: " << expected << "\n"
+                << "  actual:   " << actual << std::endl;
+      ++failures;
+    }
+    else {
+      std::cout << "OK   " << appName << std::endl;
+    }
+  }
+
+  std::cout << appNames.size() - failures << " of " << appNames.size() << " applications match" << std::endl;
+  return failures == 0 ? 0 : 1;
+}